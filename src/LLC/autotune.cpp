@@ -0,0 +1,204 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/prime/autotune.h>
+#include <LLC/include/global.h>
+#include <LLC/types/cpu_primesieve.h>
+#include <LLC/types/cpu_primetest.h>
+
+#include <TAO/Ledger/types/block.h>
+
+#include <Util/include/debug.h>
+#include <Util/include/args.h>
+#include <Util/include/runtime.h>
+#include <Util/include/prime_config.h>
+
+#include <memory>
+#include <thread>
+#include <limits>
+#include <iomanip>
+
+namespace LLC
+{
+
+    /* Run CPU sieve and test workers on a block for a while, and measure the candidates/s and WPS. */
+    void run_trial(const TAO::Ledger::Block &block, uint32_t nSieveThreads, uint32_t nTestThreads,
+                   uint32_t nSeconds, double &nCandidatesPerSecond, double &WPS)
+    {
+        std::vector<std::unique_ptr<Proof> > vProofs;
+        std::vector<std::thread> vThreads;
+        std::atomic<bool> fStop(false);
+
+        for(uint32_t tid = 0; tid < nSieveThreads; ++tid)
+            vProofs.push_back(std::unique_ptr<Proof>(new PrimeSieveCPU(tid)));
+
+        for(uint32_t tid = 0; tid < nTestThreads; ++tid)
+            vProofs.push_back(std::unique_ptr<Proof>(new PrimeTestCPU(tid)));
+
+        /* Load every worker before starting the clock, and only then initialize them,
+           so the shared sieve block is sized for all the sieve workers. */
+        for(auto& proof : vProofs)
+            proof->Load();
+
+        for(auto& proof : vProofs)
+        {
+            proof->SetBlock(block);
+            proof->Init();
+        }
+
+        /* Clear the statistics and the work and verify queues. */
+        g_work_queue.clear();
+        g_verify_queue.clear();
+        Candidates_CPU = 0;
+        Tests_CPU = 0;
+        SievedBits = 0;
+        nWeight = 0;
+
+        runtime::timer timer;
+        timer.Start();
+
+        for(auto& proof : vProofs)
+        {
+            Proof *pProof = proof.get();
+            vThreads.push_back(std::thread([pProof, &fStop]
+            {
+                while(!fStop.load() && !pProof->IsReset())
+                    pProof->Work();
+            }));
+        }
+
+        /* Let the workers run, then stop them. */
+        runtime::sleep(nSeconds * 1000);
+        fStop = true;
+
+        for(auto& proof : vProofs)
+            proof->Reset();
+
+        for(auto& thread : vThreads)
+            thread.join();
+
+        double nElapsed = timer.ElapsedMilliseconds() / 1000.0;
+
+        nCandidatesPerSecond = Candidates_CPU.load() / nElapsed;
+        WPS = nWeight.load() / (nElapsed * 10000000);
+
+        debug::log(0, FUNCTION, "nSieveBitsLog2 = ", nCPUSieveBitsLog2,
+            " nSievePrimesLog2 = ", nCPUSievePrimesLog2,
+            " threads = ", nSieveThreads, "/", nTestThreads,
+            " : ", std::fixed, std::setprecision(1), nCandidatesPerSecond, " candidates/s ",
+            std::setprecision(3), WPS, " WP/s");
+
+        for(auto& proof : vProofs)
+            proof->Shutdown();
+
+        g_work_queue.clear();
+        g_verify_queue.clear();
+    }
+
+
+    void AutoTuneCPU(uint32_t nThreads, uint32_t nSeconds)
+    {
+        if(nThreads < 2)
+        {
+            debug::error(FUNCTION, "At least two threads are needed to tune a sieve and test split");
+            return;
+        }
+
+        /* Make a test block with a full size prime origin that can never be solved. */
+        TAO::Ledger::Block block;
+        block.nChannel = 1;
+        block.nHeight = 1;
+        block.nBits = std::numeric_limits<uint32_t>::max();
+
+        while(block.ProofHash().bits() < 1024)
+            ++block.nHeight;
+
+        debug::log(0, FUNCTION, "Tuning ", nThreads, " threads, ", nSeconds, " seconds per trial");
+
+        uint32_t nBestBitsLog2 = nCPUSieveBitsLog2;
+        uint32_t nBestPrimesLog2 = nCPUSievePrimesLog2;
+        uint32_t nBestSieveThreads = nThreads / 2;
+        double nBestWPS = -1.0;
+        double nBestCandidates = -1.0;
+
+        /* Prefer the higher WPS, falling back on candidates/s when trials are too short to find chains. */
+        auto trial = [&](uint32_t nSieveThreads) -> bool
+        {
+            double nCandidates = 0;
+            double WPS = 0;
+
+            run_trial(block, nSieveThreads, nThreads - nSieveThreads, nSeconds, nCandidates, WPS);
+
+            if(WPS > nBestWPS || (WPS == nBestWPS && nCandidates > nBestCandidates))
+            {
+                nBestWPS = WPS;
+                nBestCandidates = nCandidates;
+                return true;
+            }
+
+            return false;
+        };
+
+        /* Sweep the sieve size and sieving primes at an even thread split. */
+        for(uint32_t nBitsLog2 = 21; nBitsLog2 <= 24 && !config::fShutdown.load(); ++nBitsLog2)
+        {
+            for(uint32_t nPrimesLog2 = 21; nPrimesLog2 <= 24 && !config::fShutdown.load(); ++nPrimesLog2)
+            {
+                /* Only the primes that were generated can be used. */
+                if((1u << nPrimesLog2) > nSievePrimeLimit)
+                    continue;
+
+                nCPUSieveBitsLog2 = nBitsLog2;
+                nCPUSievePrimesLog2 = nPrimesLog2;
+
+                if(trial(nBestSieveThreads))
+                {
+                    nBestBitsLog2 = nBitsLog2;
+                    nBestPrimesLog2 = nPrimesLog2;
+                }
+            }
+        }
+
+        nCPUSieveBitsLog2 = nBestBitsLog2;
+        nCPUSievePrimesLog2 = nBestPrimesLog2;
+
+        /* Sweep the sieve/test thread split with the best sieve, doubling the sieve threads. */
+        uint32_t nEvenSplit = nBestSieveThreads;
+        for(uint32_t nSieveThreads = 1; nSieveThreads < nThreads && !config::fShutdown.load(); )
+        {
+            if(nSieveThreads != nEvenSplit && trial(nSieveThreads))
+                nBestSieveThreads = nSieveThreads;
+
+            /* Try the split with a single test thread last. */
+            if(nSieveThreads == nThreads - 1)
+                break;
+
+            nSieveThreads = std::min(nSieveThreads * 2, nThreads - 1);
+        }
+
+        nCPUSieveThreads = nBestSieveThreads;
+        nCPUTestThreads = nThreads - nBestSieveThreads;
+
+        debug::log(0, FUNCTION, "Best: nSieveBitsLog2 = ", nCPUSieveBitsLog2,
+            " nSievePrimesLog2 = ", nCPUSievePrimesLog2,
+            " nSieveThreads = ", nCPUSieveThreads,
+            " nTestThreads = ", nCPUTestThreads,
+            " : ", std::fixed, std::setprecision(1), nBestCandidates, " candidates/s ",
+            std::setprecision(3), nBestWPS, " WP/s");
+
+        /* Write the best settings back to the [CPU] section of config.ini. */
+        if(prime::save_cpu_config())
+            debug::log(0, FUNCTION, "Saved [CPU] settings to config.ini");
+    }
+
+}
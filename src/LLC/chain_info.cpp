@@ -0,0 +1,89 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/include/chain_info.h>
+#include <LLC/prime/fermat.h>
+#include <LLC/prime/prime.h>
+
+namespace LLC
+{
+
+    chain_info::chain_info()
+    : nBegin(0)
+    , nLast(0)
+    , nLength(0)
+    , nResidue(0)
+    {
+        mpz_init(zEnd);
+        mpz_init(zResidue);
+    }
+
+
+    chain_info::~chain_info()
+    {
+        mpz_clear(zEnd);
+        mpz_clear(zResidue);
+    }
+
+
+    void chain_info::reset(uint32_t nOffset)
+    {
+        nBegin = nOffset;
+        nLast = nOffset;
+        nLength = 1;
+
+        /* No composite ends the chain at its first prime. */
+        nResidue = nOffset;
+    }
+
+
+    void chain_info::extend(uint32_t nOffset)
+    {
+        nLast = nOffset;
+        ++nLength;
+    }
+
+
+    void chain_info::keep(uint32_t nOffset, const mpz_t zR)
+    {
+        if(nOffset != end())
+            return;
+
+        mpz_set(zResidue, zR);
+        nResidue = nOffset;
+    }
+
+
+    uint32_t chain_info::difficulty(const mpz_t zBase)
+    {
+        mpz_add_ui(zEnd, zBase, end());
+
+        if(nResidue != end())
+            FermatResidue(zResidue, zEnd);
+
+        /* The fraction of the residue, ((n - r) << 24) / n, as GetFractionalDifficulty. */
+        mpz_sub(zResidue, zEnd, zResidue);
+        mpz_mul_2exp(zResidue, zResidue, 24);
+        mpz_tdiv_q(zResidue, zResidue, zEnd);
+
+        double nRemainder = 1000000.0 / (uint32_t)mpz_get_ui(zResidue);
+        if(nRemainder > 1.0 || nRemainder < 0.0)
+            nRemainder = 0.0;
+
+        /* The residue is used up. */
+        nResidue = nBegin;
+
+        return SetBits(nLength + nRemainder);
+    }
+
+}
@@ -13,6 +13,11 @@ ________________________________________________________________________________
 
 #include <LLC/include/global.h>
 #include <LLC/types/cpu_primesieve.h>
+#include <LLC/include/chain_info.h>
+#include <LLC/prime/mod_p.h>
+#include <LLC/prime/remainders.h>
+#include <LLC/prime/fermat.h>
+#include <LLC/prime/pattern.h>
 
 #include <TAO/Ledger/types/block.h>
 
@@ -20,29 +25,65 @@ ________________________________________________________________________________
 #include <Util/include/debug.h>
 #include <Util/include/print_colors.h>
 #include <Util/include/prime_config.h>
+#include <Util/include/bitmanip.h>
+#include <Util/include/args.h>
 
 #include <iomanip>
 #include <cstring> //memset
+#include <algorithm>
+#include <limits>
+#include <emmintrin.h>
 
 namespace LLC
 {
+    std::mutex PrimeSieveCPU::SHARED_MUTEX;
+    std::shared_ptr<sieve_info> PrimeSieveCPU::pSharedInfo;
+    std::condition_variable PrimeSieveCPU::SHARED_CONDITION;
+    std::atomic<uint32_t> PrimeSieveCPU::nSharedWorkers(0);
+
+
     PrimeSieveCPU::PrimeSieveCPU(uint32_t id)
     : Proof(id)
-    , vWorkOrigins()
-    , vBaseRemainders()
+    , pInfo()
+    , vSieveRemainders()
+    , vLaneOrigins()
+    , vSieveOffsets()
+    , vSieveArrays()
+    , vSieveCursors()
+    , vTiles()
+    , vNonces()
+    , vMeta()
+    , vBuckets()
+    , vBucketCounts()
+    , vPassHits()
+    , nOriginBegin(0)
+    , nOriginLanes(0)
+    , nPass(0)
+    , nPasses(0)
     , nSieveBits(1 << 23)
+    , nSieveWords(1 << 18)
+    , nSieveArrays(1)
     , nSievePrimes(1 << 23)
+    , nPrimeLimitB(0)
+    , nComboThreshold(8)
+    , nBitmaskA(0)
+    , nSegmentBitsLog2(18)
+    , nSegmentBits(1 << 18)
+    , nPrimeLimitSegment(0)
+    , nTilePrimeMax(512)
+    , nPrimeLimitTile(0)
+    , nTileWords(0)
+    , nBucketSize(1 << 13)
     , pBitArraySieve(nullptr)
-    , nSieveIndex(0)
-    , nBitArrayIndex(0)
     , nSievesPerOriginCPU(5)
+    , nSievesPerOriginMax(5)
+    , nInterleave(1)
+    , fPreTest(false)
+    , fShared(false)
+    , fOwner(true)
     , zPrimeOrigin()
-    , zBaseOrigin()
     , zPrimorialMod()
     , zTempVar()
-    , zFirstSieveElement()
-    , zN()
-    , zResidue()
     {
     }
 
@@ -58,18 +99,113 @@ namespace LLC
 
         /* Initialize the GMP objects. */
         mpz_init(zPrimeOrigin);
-        mpz_init(zBaseOrigin);
         mpz_init(zPrimorialMod);
         mpz_init(zTempVar);
-        mpz_init(zFirstSieveElement);
-        mpz_init(zN);
-        mpz_init(zResidue);
 
-        /* Create the bit array sieve. */
-        pBitArraySieve = (uint32_t *)malloc(nSieveBits >> 3);
+        /* Get the sieve parameters from the [CPU] configuration. */
+        nSieveBits = 1 << nCPUSieveBitsLog2;
+        nSievePrimes = std::min((uint32_t)1 << nCPUSievePrimesLog2, nSievePrimeLimit);
+        nSegmentBitsLog2 = nCPUSegmentBitsLog2;
+        nSegmentBits = 1 << nSegmentBitsLog2;
+        nComboThreshold = nCPUComboThreshold;
+        nInterleave = std::max((uint32_t)1, nCPUInterleave);
+
+        /* Keep the origins from overflowing 64 bits as they are shifted over by each sieve.
+           A sieve too large to leave room for one sieve per origin is halved until it does. */
+        uint64_t nMaxSieves = std::numeric_limits<uint64_t>::max() / nPrimorial / nSieveBits;
+        while(nMaxSieves < 2 && nSieveBits > nSegmentBits)
+        {
+            nSieveBits >>= 1;
+            nMaxSieves = std::numeric_limits<uint64_t>::max() / nPrimorial / nSieveBits;
+        }
+
+        if(nSieveBits != (1u << nCPUSieveBitsLog2))
+            debug::log(0, FUNCTION, "nSieveBitsLog2 = ", nCPUSieveBitsLog2, " leaves no sieve per origin, using ", convert::ctz(nSieveBits));
+
+        nSievesPerOriginMax = (uint32_t)std::min(nMaxSieves ? nMaxSieves - 1 : 0, (uint64_t)std::numeric_limits<uint32_t>::max() / vOrigins.size());
+        nSievesPerOriginMax = std::max((uint32_t)1, nSievesPerOriginMax);
+        nSievesPerOriginCPU = std::max((uint32_t)1, std::min(nCPUSievesPerOrigin, nSievesPerOriginMax));
+
+        /* Flatten the sieving offsets. The A offsets share the first bit array,
+           and each B offset is sieved into a bit array of its own for the combo. */
+        vSieveOffsets.clear();
+        vSieveArrays.clear();
+        nBitmaskA = 0;
+
+        for(uint32_t o = 0; o < vOffsetsA.size(); ++o)
+        {
+            vSieveOffsets.push_back(vOffsets[vOffsetsA[o]]);
+            vSieveArrays.push_back(0);
+            nBitmaskA |= 1 << vOffsetsA[o];
+        }
+
+        for(uint32_t o = 0; o < vOffsetsB.size(); ++o)
+        {
+            vSieveOffsets.push_back(vOffsets[vOffsetsB[o]]);
+            vSieveArrays.push_back(1 + o);
+        }
+
+        nSieveArrays = 1 + vOffsetsB.size();
+        nSieveWords = nSieveBits >> 5;
+
+        /* The threshold can't be larger than the number of sieved offsets. */
+        nComboThreshold = std::min(nComboThreshold, (uint32_t)vSieveOffsets.size());
+
+        /* By default the sieve only emits survivors and the test workers pretest them. */
+        fPreTest = config::GetBoolArg(std::string("-sievepretest"));
+
+        /* When the block is shared, worker 0 owns it and the other workers join it. */
+        fShared = nCPUSharedSieve != 0;
+        fOwner = !fShared || nID == 0;
+
+        /* Count the workers sharing the block, so it is sized for all of them. */
+        if(fShared)
+            ++nSharedWorkers;
+
+        /* Create the bit array sieves, A followed by each B, for each interleaved origin. */
+        pBitArraySieve = (uint32_t *)malloc(nInterleave * nSieveArrays * (nSieveBits >> 3));
+
+        /* Create empty initial sieve remainders, the interleaved origins of a prime side by side. */
+        vSieveRemainders.assign(nSievePrimes * nInterleave, 0);
+        vLaneOrigins.assign(nInterleave, 0);
+
+        /* Create the candidate buffers, reused by every sieve. */
+        vNonces.reserve(nSieveBits >> 8);
+        vMeta.reserve(nSieveBits >> 8);
+
+        /* Find the first prime at least as large as a segment. Smaller primes hit
+           every segment and are sieved window by window from their cursors. */
+        nPrimeLimitSegment = nPrimorialEndPrime;
+        while(nPrimeLimitSegment < nSievePrimes && primes[nPrimeLimitSegment] < nSegmentBits)
+            ++nPrimeLimitSegment;
+
+        /* Find prime limit B, the first prime larger than the bit array. Like the GPU,
+           the combo offsets are not sieved any further than that. */
+        nPrimeLimitB = nPrimorialEndPrime;
+        while(nPrimeLimitB < nSievePrimes && primes[nPrimeLimitB] <= nSieveBits)
+            ++nPrimeLimitB;
 
-        /* Create empty initial base remainders. */
-        vBaseRemainders.assign(nSievePrimes, 0);
+        /* Find the end of the tile primes, which are laid down as repeating patterns. */
+        nPrimeLimitTile = nPrimorialEndPrime;
+        nTileWords = 0;
+        while(nPrimeLimitTile < nPrimeLimitSegment && primes[nPrimeLimitTile] < nTilePrimeMax)
+            nTileWords += primes[nPrimeLimitTile++];
+
+        /* Create the pattern tiles, p words for each tile prime of each bit array. */
+        vTiles.assign(nSieveArrays * nTileWords, 0);
+
+        /* Create the next-hit cursors for each segmented prime and offset. */
+        vSieveCursors.assign(nPrimeLimitSegment * vSieveOffsets.size(), 0);
+
+        /* Create a fixed size bucket of large prime hits for each segment of each bit array. */
+        uint32_t nSegments = (nSieveBits + nSegmentBits - 1) >> nSegmentBitsLog2;
+        vBuckets.assign(nInterleave * nSieveArrays * nSegments * nBucketSize, 0);
+        vBucketCounts.assign(nInterleave * nSieveArrays * nSegments, 0);
+
+        debug::log(3, FUNCTION, "PrimeSieveCPU", static_cast<uint32_t>(nID), " nSieveBits = ", nSieveBits,
+            " nSievePrimes = ", nSievePrimes, " nSegmentBits = ", nSegmentBits,
+            " nPrimeLimitSegment = ", nPrimeLimitSegment, " nPrimeLimitB = ", nPrimeLimitB,
+            " nInterleave = ", nInterleave);
     }
 
 
@@ -79,76 +215,189 @@ namespace LLC
 
         /* Atomic set reset flag to false. */
         fReset = false;
-        nSieveIndex = 0;
-        nBitArrayIndex = 0;
-        vWorkOrigins = vOrigins;
-
-        /* Set the prime origin from the block hash. */
-        uint1024_t nPrimeOrigin = block.ProofHash();
-        mpz_import(zPrimeOrigin, 32, -1, sizeof(uint32_t), 0, 0, nPrimeOrigin.begin());
+        pInfo.reset();
 
+        /* Drop the origins claimed from the last block. */
+        nPass = 0;
+        nPasses = 0;
 
-        /* Compute the primorial mod from the origin. */
-        mpz_mod(zPrimorialMod, zPrimeOrigin, zPrimorial);
-        mpz_sub(zPrimorialMod, zPrimorial, zPrimorialMod);
-        mpz_add(zBaseOrigin, zPrimeOrigin, zPrimorialMod);
+        /* Only the owner of the block does the per-block setup. */
+        if(fOwner)
+            init_block();
     }
 
 
     bool PrimeSieveCPU::Work()
     {
-        uint32_t nOrigins = vWorkOrigins.size();
-
         /* Check for early out. */
         if(fReset.load())
             return false;
 
-        /* Get the current origin index. */
-        uint32_t nOriginIndex = nSieveIndex % nOrigins;
+        /* Claim the next origins once all the sieves of the claimed ones are done. */
+        if(nPass == nPasses)
+        {
+            /* Wait for the owner to publish a shared block. */
+            if(!fOwner && !join_block())
+                return false;
+
+            /* Claim the next origins of the block, one for each interleaved lane. Their
+               sieves are all done by this worker, so the large primes carry over their
+               next hits from one sieve to the next instead of computing them again. */
+            uint32_t nOrigin = pInfo->nCursor.fetch_add(nInterleave);
+            if(nOrigin >= pInfo->nOrigins)
+            {
+                /* The owner requests the next block once the current one is used up. */
+                if(fOwner)
+                {
+                    debug::log(0, FUNCTION, (uint32_t)nID, " - Requesting more work");
+                    fReset = true;
+                }
+
+                return false;
+            }
+
+            nOriginBegin = nOrigin;
+            nOriginLanes = std::min(nInterleave, pInfo->nOrigins - nOrigin);
+            nPass = 0;
+            nPasses = pInfo->nSievesPerOrigin;
+
+            /* Create an empty list of carried hits for each sieve of each origin. */
+            vPassHits.resize(nInterleave * nPasses);
+            for(uint32_t j = 0; j < vPassHits.size(); ++j)
+                vPassHits[j].clear();
+        }
+
+        uint32_t nLanes = nOriginLanes;
 
-        /* Compute first sieving element. */
-        mpz_add_ui(zFirstSieveElement, zBaseOrigin, vWorkOrigins[nOriginIndex]);
+        /* Get the origin of the first sieving element of each sieve. Each sieve
+           of an origin shifts it over by an entire sieve range. */
+        for(uint32_t k = 0; k < nLanes; ++k)
+            vLaneOrigins[k] = vOrigins[nOriginBegin + k] + nPass * nPrimorial * nSieveBits;
 
-        /* Compute the base remainders. */
-        for(uint32_t i = nPrimorialEndPrime; i < nSievePrimes; ++i)
+        /* Compute the remainders of the first sieving elements from the base remainders,
+           the same way the GPU does, with one reciprocal reduction per prime. The large
+           primes only need them for their first hits, on the first sieve of the origins. */
+        const uint32_t *pBaseRemainders = pInfo->vBaseRemainders.data();
+        uint32_t nPrimeLimit = (nPass == 0) ? nSievePrimes : nPrimeLimitSegment;
+        for(uint32_t i = nPrimorialEndPrime; i < nPrimeLimit; ++i)
         {
             /* Get the global sieving prime. */
             uint32_t p   = primesInverseInvk[i * 4];
-            vBaseRemainders[i] = mpz_tdiv_ui(zFirstSieveElement, p);
+            uint64_t recip = get_recip(primesInverseInvk, i);
+            uint32_t *pRemainders = &vSieveRemainders[i * nInterleave];
+
+            for(uint32_t k = 0; k < nLanes; ++k)
+                pRemainders[k] = mod_p_small(vLaneOrigins[k] + pBaseRemainders[i], p, recip);
         }
 
 
-        /* sieve the bit array */
-        cpu_sieve();
+        /* sieve the bit arrays */
+        cpu_sieve(nLanes);
 
         /* Add nonce offsets to queue. */
-        cpu_compact(vWorkOrigins[nOriginIndex]);
+        for(uint32_t k = 0; k < nLanes; ++k)
+            cpu_compact(k, vLaneOrigins[k]);
+
+        SievedBits += nLanes * nSieveBits;
+
+        /* Move on to the next sieve of the claimed origins. */
+        ++nPass;
+
+        return false;
+    }
+
+
+    void PrimeSieveCPU::Reset()
+    {
+        Proof::Reset();
+
+        if(fShared)
+        {
+            /* Withdraw the shared block so the other workers stop sieving it. */
+            {
+                std::unique_lock<std::mutex> lk(SHARED_MUTEX);
+                if(fOwner)
+                    pSharedInfo.reset();
+            }
+
+            /* Wake up the workers waiting for a block, so they see their reset flag. */
+            SHARED_CONDITION.notify_all();
+        }
+    }
+
 
-        bool fNewSieve = nOriginIndex == 0;
-        bool fLastSieve = nBitArrayIndex == nSievesPerOriginCPU - 1;
+    void PrimeSieveCPU::init_block()
+    {
+        /* A shared block is sieved by all the sharing workers, so it gets sieves for
+           each of them, the same as each of them would get with a block of their own. */
+        uint32_t nSievesPerOrigin = nSievesPerOriginCPU;
+        if(fShared)
+            nSievesPerOrigin = (uint32_t)std::min((uint64_t)nSievesPerOriginCPU * std::max(nSharedWorkers.load(), 1u), (uint64_t)nSievesPerOriginMax);
+
+        /* A block without sieves would leave the workers asking for work forever. */
+        nSievesPerOrigin = std::max(nSievesPerOrigin, 1u);
+
+        std::shared_ptr<sieve_info> pNewInfo =
+            std::make_shared<sieve_info>(GetBlock(), nSievePrimes, vOrigins.size(), nSievesPerOrigin);
 
-        /* Determine if we should synchronize early due to running out of work. */
-        bool fSynchronize = fNewSieve && fLastSieve;
+        /* Tag the work of this block with the current round. */
+        pNewInfo->nEpoch = g_work_queue.epoch();
 
+        /* Set the prime origin from the block hash. */
+        uint1024_t nPrimeOrigin = pNewInfo->block.ProofHash();
+        mpz_import(zPrimeOrigin, 32, -1, sizeof(uint32_t), 0, 0, nPrimeOrigin.begin());
 
-        /* Increment the sieve index. */
-        ++nSieveIndex;
-        SievedBits += nSieveBits;
 
+        /* Compute the primorial mod from the origin. */
+        mpz_mod(zPrimorialMod, zPrimeOrigin, zPrimorial);
+        mpz_sub(zPrimorialMod, zPrimorial, zPrimorialMod);
+        mpz_add(pNewInfo->zBaseOrigin, zPrimeOrigin, zPrimorialMod);
 
-        if(fNewSieve)
-            ++nBitArrayIndex;
+        /* Compute the base remainders once per block. Each sieve only moves the
+           64-bit origin, so its remainders are derived from these without GMP. */
+        ComputeRemainders(pNewInfo->zBaseOrigin, nPrimorialEndPrime, nSievePrimes, pNewInfo->vBaseRemainders.data());
 
-        /* Shift the working origin over by an entire sieve range. */
-        vWorkOrigins[nOriginIndex] += nPrimorial * nSieveBits;
+        pInfo = pNewInfo;
 
-        if(fSynchronize)
+        /* Publish the block to the other sieve workers, waking up the ones waiting for it. */
+        if(fShared)
         {
-            debug::log(0, FUNCTION, (uint32_t)nID, " - Requesting more work");
-            fReset = true;
+            {
+                std::unique_lock<std::mutex> lk(SHARED_MUTEX);
+                pSharedInfo = pNewInfo;
+            }
+
+            SHARED_CONDITION.notify_all();
         }
+    }
 
-        return false;
+
+    bool PrimeSieveCPU::join_block()
+    {
+        std::shared_ptr<sieve_info> pNewInfo;
+        {
+            std::unique_lock<std::mutex> lk(SHARED_MUTEX);
+
+            /* Wait for a block with origins left to claim. The cursor only moves
+               forward, so only a newly published block ends the wait. */
+            SHARED_CONDITION.wait(lk, [this]
+            {
+                return fReset.load() || (pSharedInfo && pSharedInfo->nCursor.load() < pSharedInfo->nOrigins);
+            });
+
+            if(fReset.load())
+                return false;
+
+            pNewInfo = pSharedInfo;
+        }
+
+        /* Take a copy of a newly published block for the work we queue. */
+        if(pNewInfo && pNewInfo != pInfo)
+            SetBlock(pNewInfo->block);
+
+        pInfo = pNewInfo;
+
+        return pInfo != nullptr;
     }
 
 
@@ -156,17 +405,17 @@ namespace LLC
     {
         debug::log(3, FUNCTION, "PrimeSieveCPU", static_cast<uint32_t>(nID));
 
-        /* Atomic set reset flag to true. */
-        fReset = true;
+        /* Atomic set reset flag to true, and let go of the block. */
+        Reset();
+        pInfo.reset();
+
+        if(fShared)
+            --nSharedWorkers;
 
         /* Free the GMP object memory. */
         mpz_clear(zPrimeOrigin);
-        mpz_clear(zBaseOrigin);
         mpz_clear(zPrimorialMod);
         mpz_clear(zTempVar);
-        mpz_clear(zFirstSieveElement);
-        mpz_clear(zN);
-        mpz_clear(zResidue);
 
 
         /* Free the bit array sieve memory. */
@@ -174,73 +423,276 @@ namespace LLC
     }
 
 
-    void PrimeSieveCPU::cpu_sieve()
+    void PrimeSieveCPU::cpu_sieve(uint32_t nLanes)
     {
-        /* Clear the bit array. */
-        memset(pBitArraySieve, 0x00, nSieveBits >> 3);
+        uint32_t nOffsets = vSieveOffsets.size();
 
-        /* Loop through and sieve with each sieving offset. */
-        for(uint32_t o = 0; o < vOffsetsA.size(); ++o)
+        /* The small primes stay in cache, so they are sieved one origin at a time. */
+        for(uint32_t k = 0; k < nLanes; ++k)
         {
-            /* Loop through each sieving prime and sieve. */
-            for(uint32_t i = nPrimorialEndPrime; i < nSievePrimes && !fReset.load(); ++i)
-                sieve_offset(i, o);
+            /* Lay down the hits of the smallest primes into their pattern tiles. */
+            build_tiles(k);
+
+            /* Compute the first hit of each segmented prime for every offset. */
+            for(uint32_t i = nPrimeLimitTile; i < nPrimeLimitSegment; ++i)
+            {
+                for(uint32_t o = 0; o < nOffsets; ++o)
+                    vSieveCursors[i * nOffsets + o] = sieve_index(i, o, k);
+            }
+
+            /* Finish one cache sized segment for all small primes and offsets before moving on. */
+            for(uint32_t nBegin = 0; nBegin < nSieveBits && !fReset.load(); nBegin += nSegmentBits)
+                sieve_segment(k, nBegin, std::min(nBegin + nSegmentBits, nSieveBits));
         }
+
+        /* Sieve the remaining large primes through the segment buckets, all origins at once. */
+        bucket_sieve(nLanes);
     }
 
 
-    void PrimeSieveCPU::cpu_compact(uint64_t base_offset)
+    void PrimeSieveCPU::build_tiles(uint32_t nLane)
     {
-        std::vector<uint64_t> vNonces;
-        std::vector<uint32_t> vMeta;
+        uint32_t nOffsets = vSieveOffsets.size();
+        uint32_t nTile = 0;
 
-        uint64_t nonce;
+        for(uint32_t i = nPrimorialEndPrime; i < nPrimeLimitTile; ++i)
+        {
+            /* Get the global sieving prime. */
+            uint32_t p = primesInverseInvk[i * 4];
+            uint32_t nTileBits = p << 5;
+
+            for(uint32_t nArray = 0; nArray < nSieveArrays; ++nArray)
+                memset(&vTiles[nArray * nTileWords + nTile], 0x00, p * sizeof(uint32_t));
 
-        for(uint32_t i = 0; i < nSieveBits && !fReset.load(); ++i)
+            /* Every offset of a bit array shares the same tile for this prime. */
+            for(uint32_t o = 0; o < nOffsets; ++o)
+            {
+                uint32_t *pTile = &vTiles[vSieveArrays[o] * nTileWords + nTile];
+
+                for(uint32_t index = sieve_index(i, o, nLane); index < nTileBits; index += p)
+                    pTile[index >> 5] |= (1 << (index & 31));
+            }
+
+            nTile += p;
+        }
+    }
+
+
+    void PrimeSieveCPU::sieve_segment(uint32_t nLane, uint32_t nBegin, uint32_t nEnd)
+    {
+        uint32_t nWordBegin = nBegin >> 5;
+        uint32_t nWords = (nEnd - nBegin) >> 5;
+        uint32_t *pBitArray = &pBitArraySieve[nLane * nSieveArrays * nSieveWords];
+
+        for(uint32_t nArray = 0; nArray < nSieveArrays; ++nArray)
         {
-            /* Make sure this offset survived the sieve. */
-            if(pBitArraySieve[i >> 5] & (1 << (i & 31)))
-                continue;
+            uint32_t *pWords = &pBitArray[nArray * nSieveWords + nWordBegin];
+            const uint32_t *pTile = &vTiles[nArray * nTileWords];
 
-            nonce = base_offset + (uint64_t)i * nPrimorial;
+            /* Clear the window if there are no tiles to lay down. */
+            if(nPrimeLimitTile == nPrimorialEndPrime)
+                memset(pWords, 0x00, nWords * sizeof(uint32_t));
 
-            /* If there was at least one prime found, add it to the list. */
-            if(cpu_pretest(nonce, 0))
+            /* Initialize the window by copying the first tile and combining the rest. */
+            for(uint32_t i = nPrimorialEndPrime; i < nPrimeLimitTile; ++i)
             {
-                ++PrimesFound[0];
-                vNonces.push_back(nonce);
-                vMeta.push_back(0);
+                /* Get the global sieving prime, which is also the tile length. */
+                uint32_t p = primesInverseInvk[i * 4];
+                uint32_t k = nWordBegin % p;
+                bool fFirst = (i == nPrimorialEndPrime);
+
+                for(uint32_t w = 0; w < nWords; k = 0)
+                {
+                    uint32_t n = std::min(p - k, nWords - w);
+                    uint32_t *__restrict pDst = &pWords[w];
+                    const uint32_t *__restrict pSrc = &pTile[k];
+
+                    if(fFirst)
+                        memcpy(pDst, pSrc, n * sizeof(uint32_t));
+                    else
+                    {
+                        uint32_t j = 0;
+
+                        /* Combine four words at a time with a vector OR. */
+                        for(; j + 4 <= n; j += 4)
+                        {
+                            __m128i a = _mm_loadu_si128((const __m128i *)&pDst[j]);
+                            __m128i b = _mm_loadu_si128((const __m128i *)&pSrc[j]);
+                            _mm_storeu_si128((__m128i *)&pDst[j], _mm_or_si128(a, b));
+                        }
+
+                        for(; j < n; ++j)
+                            pDst[j] |= pSrc[j];
+                    }
+
+                    w += n;
+                }
+
+                pTile += p;
             }
+        }
+
+        /* Sieve the remaining small primes with the kernel of the offset pattern. */
+        switch(nOffsetPattern)
+        {
+            case PATTERN_217153:
+                sieve_primes<PATTERN_217153>(pBitArray, nEnd);
+                break;
+
+            default:
+                sieve_primes<PATTERN_GENERIC>(pBitArray, nEnd);
+                break;
+        }
+    }
+
+
+    template<uint32_t nPattern>
+    void PrimeSieveCPU::sieve_primes(uint32_t *pBitArray, uint32_t nEnd)
+    {
+        typedef offset_pattern<nPattern> pattern;
+
+        uint32_t nOffsets = pattern::sizeA() + pattern::sizeB();
+        uint32_t *pCursor = &vSieveCursors[nPrimeLimitTile * nOffsets];
+
+        for(uint32_t i = nPrimeLimitTile; i < nPrimeLimitSegment; ++i)
+        {
+            /* Get the global sieving prime. */
+            uint32_t p = primesInverseInvk[i * 4];
+
+            for(uint32_t o = 0; o < nOffsets; ++o, ++pCursor)
+            {
+                uint32_t *pSieve = &pBitArray[sieve_array<nPattern>(o) * nSieveWords];
+                uint32_t index = *pCursor;
+
+                /* Sieve up to the end of this segment. */
+                for(; index < nEnd; index += p)
+                    pSieve[index >> 5] |= (1 << (index & 31));
+
+                /* Save where this prime and offset resume in the next segment. */
+                *pCursor = index;
+            }
+        }
+    }
+
+
+    void PrimeSieveCPU::cpu_compact(uint32_t nLane, uint64_t base_offset)
+    {
+        /* Compact with the kernel of the offset pattern. */
+        switch(nOffsetPattern)
+        {
+            case PATTERN_217153:
+                compact<PATTERN_217153>(nLane, base_offset);
+                break;
+
+            default:
+                compact<PATTERN_GENERIC>(nLane, base_offset);
+                break;
+        }
+    }
+
+
+    template<uint32_t nPattern>
+    void PrimeSieveCPU::compact(uint32_t nLane, uint64_t base_offset)
+    {
+        typedef offset_pattern<nPattern> pattern;
+
+        const uint32_t *pSieveA = &pBitArraySieve[nLane * nSieveArrays * nSieveWords];
+        const uint32_t *pSieveB = &pSieveA[nSieveWords];
+        uint32_t nOffsetsB = pattern::sizeB();
+
+        uint64_t nonce;
+
+        /* Pretest here when set to, or when the test workers can't keep up. Testing
+           on the sieve thread slows the sieve down and thins out the candidates. */
+        bool fSievePreTest = fPreTest || g_work_queue.pressure() >= WORK_PRESSURE_SHED;
+
+        /* Reuse the candidate buffers from the last sieve. */
+        vNonces.clear();
+        vMeta.clear();
+
+        for(uint32_t index = 0; index < nSieveWords && !fReset.load(); ++index)
+        {
+            /* Get the offsets that survived the sieve in this word. */
+            uint32_t nSurvivors = ~pSieveA[index];
+
+            /* Visit each survivor by its trailing zeros, clearing it when done. */
+            for(; nSurvivors; nSurvivors &= (nSurvivors - 1))
+            {
+                uint32_t nBit = convert::ctz(nSurvivors);
+                uint32_t mask = 1 << nBit;
+
+                /* Start from the A offsets and add each B offset that survived its sieve. */
+                uint32_t combo = nBitmaskA;
+                for(uint32_t o = 0; o < nOffsetsB; ++o)
+                {
+                    if((pSieveB[o * nSieveWords + index] & mask) == 0)
+                        combo |= 1 << pattern::indexB(o);
+                }
+
+                /* Get the count of the remaining bits and compare to threshold. */
+                uint32_t nRemaining = convert::popc(combo);
+                if(nRemaining < nComboThreshold)
+                    continue;
+
+                /* Count the surviving offsets up to the first rule-breaking prime gap. */
+                uint32_t t = convert::ctz(combo);
+                uint32_t nCount = 1;
+                for(uint32_t bits = combo & (combo - 1); bits; bits &= (bits - 1), ++nCount)
+                {
+                    uint32_t n = convert::ctz(bits);
+
+                    if(pattern::offset(n) - pattern::offset(t) > CHAIN_GAP_MAX)
+                        break;
+
+                    t = n;
+                }
+
+                if(nCount < nComboThreshold)
+                    continue;
+
+                nonce = base_offset + (uint64_t)((index << 5) + nBit) * nPrimorial;
+
+                /* Only pretest the first offset here if the sieve thread is set to. */
+                if(fSievePreTest)
+                {
+                    ++PrimesChecked[0];
+                    ++Tests_CPU;
+
+                    if(!cpu_pretest(nonce, 0))
+                        continue;
 
-            ++PrimesChecked[0];
-            ++Tests_CPU;
+                    ++PrimesFound[0];
+                }
+
+                vNonces.push_back(nonce);
+                vMeta.push_back(~combo);
+            }
         }
 
+        Candidates_CPU += vNonces.size();
+
         if(vNonces.size())
         {
-            /* Atomic add nonces to work queue for testing. */
-            std::unique_lock<std::mutex> lk(g_work_mutex);
-            g_work_queue.emplace_back(work_info(vNonces, vMeta, block, nID));
+            /* Mark the first offset as tested if it was pretested here. */
+            uint32_t nTested = fSievePreTest ? 1 : 0;
+
+            /* Add nonces to work queue for testing, waking up a test worker. */
+            g_work_queue.push(work_info(vNonces, vMeta, block, nID, nTested, pInfo->nEpoch));
         }
     }
 
 
     bool PrimeSieveCPU::cpu_pretest(uint64_t nonce, uint32_t o)
     {
-        mpz_add_ui(zTempVar, zBaseOrigin, nonce);
+        mpz_add_ui(zTempVar, pInfo->zBaseOrigin, nonce);
         mpz_add_ui(zTempVar, zTempVar, vOffsets[o]);
 
         /*Check for Fermat test. */
-        mpz_sub_ui(zN, zTempVar, 1);
-        mpz_powm(zResidue, zTwo, zN, zTempVar);
-        if(mpz_cmp_ui(zResidue, 1) == 0)
-            return true;
-
-        return false;
+        return FermatPrime(zTempVar);
     }
 
 
-    void PrimeSieveCPU::sieve_offset(uint32_t i, uint32_t o)
+    uint32_t PrimeSieveCPU::sieve_index(uint32_t i, uint32_t o, uint32_t nLane)
     {
         /* index into primesInverseInvk */
         uint32_t idx = i * 4;
@@ -251,25 +703,133 @@ namespace LLC
 
 
         /* Compute remainder. */
-        uint32_t remainder = vBaseRemainders[i] + vOffsets[vOffsetsA[o]];
-
-        if(p < remainder)
-            remainder -= p;
+        uint32_t remainder = add_mod_p(vSieveRemainders[i * nInterleave + nLane], vSieveOffsets[o], p);
 
         uint64_t r = (uint64_t)(p - remainder) * (uint64_t)inv;
 
         /* Compute the starting sieve array index. */
-        uint32_t index = r % p;
+        return mod_p_small(r, p, get_recip(primesInverseInvk, i));
+    }
+
+
+    /* Offsets past the smallest sieving primes need more than one subtraction. */
+    static_assert(add_mod_p(5, 10, 23) == 15, "add_mod_p: sum below p");
+    static_assert(add_mod_p(22, 1, 23) == 0, "add_mod_p: sum of p");
+    static_assert(add_mod_p(20, 10, 23) == 7, "add_mod_p: sum below 2p");
+    static_assert(add_mod_p(22, 30, 23) == 6, "add_mod_p: offset larger than p");
+    static_assert(add_mod_p(16, 76, 23) == 0, "add_mod_p: sum of 4p");
+
 
-        /* Sieve. */
-        while (index < nSieveBits)
+    void PrimeSieveCPU::bucket_sieve(uint32_t nLanes)
+    {
+        uint32_t nSegments = vBucketCounts.size() / (nInterleave * nSieveArrays);
+        uint32_t nBuckets = nLanes * nSieveArrays * nSegments;
+        uint32_t nSieveBitsLog2 = convert::ctz(nSieveBits);
+
+        /* The first hits are only computed when the worker switches origins. */
+        if(nPass == 0)
+            bucket_init(nLanes);
+
+        for(uint32_t k = 0; k < nLanes && !fReset.load(); ++k)
         {
-            pBitArraySieve[index >> 5] |= (1 << (index & 31));
-            index += p;
+            std::vector<uint32_t> &vHits = vPassHits[k * nPasses + nPass];
+
+            for(uint32_t j = 0; j < vHits.size(); j += 2)
+            {
+                /* Get the global sieving prime and the bit array it sieves. */
+                uint32_t nPrime = vHits[j + 1];
+                uint32_t p = primesInverseInvk[(nPrime >> 4) * 4];
+                uint32_t nBucketBegin = (k * nSieveArrays + (nPrime & 15)) * nSegments;
+
+                /* Drop each hit into the bucket of its segment. */
+                uint32_t index = vHits[j];
+                for(; index < nSieveBits; index += p)
+                {
+                    uint32_t nBucket = nBucketBegin + (index >> nSegmentBitsLog2);
+                    uint32_t &nCount = vBucketCounts[nBucket];
+
+                    vBuckets[nBucket * nBucketSize + nCount] = index;
+
+                    /* Apply a full bucket while its segment is the only one touched. */
+                    if(++nCount == nBucketSize)
+                        bucket_flush(nBucket);
+                }
+
+                /* Carry the next hit over to the sieve of the origin it falls in, if any. */
+                uint32_t nNext = nPass + (index >> nSieveBitsLog2);
+                if(nNext < nPasses)
+                {
+                    std::vector<uint32_t> &vNext = vPassHits[k * nPasses + nNext];
+                    vNext.push_back(index & (nSieveBits - 1));
+                    vNext.push_back(nPrime);
+                }
+            }
+
+            vHits.clear();
         }
+
+        /* Apply what is left in each bucket. */
+        for(uint32_t nBucket = 0; nBucket < nBuckets; ++nBucket)
+            bucket_flush(nBucket);
     }
 
 
+    void PrimeSieveCPU::bucket_init(uint32_t nLanes)
+    {
+        uint32_t nOffsets = vSieveOffsets.size();
+        uint32_t nOffsetsA = vOffsetsA.size();
+        uint32_t nSieveBitsLog2 = convert::ctz(nSieveBits);
+        uint32_t nChunkPrimes = 1 << 12;
+
+        /* Prime major order, a cache sized chunk of primes at a time, so each prime,
+           inverse, and remainder is only loaded from memory once and then applied
+           to every interleaved origin from cache. */
+        for(uint32_t nChunk = nPrimeLimitSegment; nChunk < nSievePrimes && !fReset.load(); nChunk += nChunkPrimes)
+        {
+            uint32_t nChunkEnd = std::min(nChunk + nChunkPrimes, nSievePrimes);
 
+            for(uint32_t k = 0; k < nLanes; ++k)
+            {
+                for(uint32_t i = nChunk; i < nChunkEnd; ++i)
+                {
+                    /* The combo offsets stop at prime limit B, the A offsets keep going. */
+                    uint32_t nOffsetsPrime = (i < nPrimeLimitB) ? nOffsets : nOffsetsA;
+
+                    for(uint32_t o = 0; o < nOffsetsPrime; ++o)
+                    {
+                        uint32_t index = sieve_index(i, o, k);
+
+                        /* Primes past the range of the claimed sieves never hit them. */
+                        uint32_t nNext = index >> nSieveBitsLog2;
+                        if(nNext < nPasses)
+                        {
+                            std::vector<uint32_t> &vNext = vPassHits[k * nPasses + nNext];
+                            vNext.push_back(index & (nSieveBits - 1));
+                            vNext.push_back((i << 4) | vSieveArrays[o]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    void PrimeSieveCPU::bucket_flush(uint32_t nBucket)
+    {
+        const uint32_t *pBucket = &vBuckets[nBucket * nBucketSize];
+        uint32_t nCount = vBucketCounts[nBucket];
+        uint32_t nSegments = vBucketCounts.size() / (nInterleave * nSieveArrays);
+
+        /* Buckets are sieve major, so find the bit array this one belongs to. */
+        uint32_t *pSieve = &pBitArraySieve[(nBucket / nSegments) * nSieveWords];
+
+        for(uint32_t j = 0; j < nCount; ++j)
+        {
+            uint32_t index = pBucket[j];
+            pSieve[index >> 5] |= (1 << (index & 31));
+        }
+
+        vBucketCounts[nBucket] = 0;
+    }
 
 }
@@ -13,6 +13,8 @@ ________________________________________________________________________________
 
 #include <LLC/include/global.h>
 #include <LLC/types/cpu_primetest.h>
+#include <LLC/prime/pattern.h>
+#include <LLC/prime/mod_p.h>
 
 #include <TAO/Ledger/types/block.h>
 
@@ -21,7 +23,9 @@ ________________________________________________________________________________
 #include <Util/include/print_colors.h>
 #include <Util/include/prime_config.h>
 #include <Util/include/bitmanip.h>
+#include <Util/include/args.h>
 #include <bitset>
+#include <algorithm>
 
 #include <iomanip>
 
@@ -48,16 +52,18 @@ namespace LLC
     PrimeTestCPU::PrimeTestCPU(uint32_t id)
     : Proof(id)
     , zTempVar()
-    , zN()
     , zBaseOffsetted()
-    , zBaseOrigin()
-    , zPrimeOrigin()
-    , zResidue()
-    , zPrimorialMod()
     , work()
-    , mapTest()
+    , nCandidates(0)
+    , context()
+    , vTrial()
+    , nSievedMask(0)
     , gpu_begin(32)
     , gpu_end(0)
+    , nPreTestMin(1)
+    , nPreTestMax(4)
+    , nMinChain(0)
+    , nTestLevels(1)
     {
     }
 
@@ -73,28 +79,39 @@ namespace LLC
 
         mpz_init(zTempVar);
         mpz_init(zBaseOffsetted);
-        mpz_init(zN);
-        mpz_init(zBaseOrigin);
-        mpz_init(zPrimeOrigin);
-        mpz_init(zResidue);
-        mpz_init(zPrimorialMod);
 
-        /* Store a map of false positives for GPU Fermat offset tests. */
-        for(uint8_t i = 0; i < vOffsetsT.size(); ++i)
-            mapTest[vOffsetsT[i]] = i;
+        for(uint32_t i = 0; i < FERMAT_BATCH_MAX; ++i)
+        {
+            mpz_init(zBatch[i]);
+            mpz_init(zResidues[i]);
+        }
+
+        /* Get the range of offsets to pretest candidates from the CPU sieve with. */
+        nPreTestMin = config::GetArg(std::string("-cpupretest"), nCPUPreTestMin);
+        nPreTestMax = std::max(nPreTestMin, (uint32_t)config::GetArg(std::string("-cpupretestmax"), nCPUPreTestMax));
+
+        /* Get the chain length below which candidates are abandoned, zero tests them all. */
+        nMinChain = config::GetArg(std::string("-cpuminchain"), nCPUMinChain);
+
+        /* Get the number of levels the offsets are tested in across the candidates. */
+        nTestLevels = std::max((int64_t)1, config::GetArg(std::string("-cputestlevels"), nCPUTestLevels));
 
         /* Find the begin and end offsets for gpu sieving */
         for(uint8_t i = 0; i < vOffsetsA.size(); ++i)
         {
             gpu_begin = std::min(gpu_begin, vOffsetsA[i]);
             gpu_end = std::max(gpu_end, vOffsetsA[i]);
+            nSievedMask |= 1 << vOffsetsA[i];
         }
         for(uint8_t i = 0; i < vOffsetsB.size(); ++i)
         {
             gpu_begin = std::min(gpu_begin, vOffsetsB[i]);
             gpu_end = std::max(gpu_end, vOffsetsB[i]);
+            nSievedMask |= 1 << vOffsetsB[i];
         }
 
+        vTrial.resize(WORK_CHUNK_SIZE * TEST_TRIAL_PRIMES);
+
     }
 
 
@@ -109,215 +126,327 @@ namespace LLC
 
     bool PrimeTestCPU::Work()
     {
-        bool have_work = false;
+        uint32_t nDepth = 0;
 
         if(fReset.load())
             return false;
 
 
-        /* Check the work queue for nonce results from GPU. */
+        /* Wait on the work queue for nonce results from the sieves. */
+        if(!g_work_queue.pop(nID, work, nDepth, fReset))
+            return false;
+
+        /* Set the block. */
+        block = *work.block;
+
+        /* Get the proof hash and origins of the block, shared by the test workers.
+           Consecutive chunks are mostly of the same block, so check the last one first. */
+        if(!context || !context->matches(block))
+            context = g_test_contexts.get(block);
+
+        /* Test the work with the kernels of the offset pattern. */
+        switch(nOffsetPattern)
         {
-            std::unique_lock<std::mutex> lk(g_work_mutex);
-            if (!g_work_queue.empty())
-            {
-                work = g_work_queue.front();
-                g_work_queue.pop_front();
+            case PATTERN_217153:
+                return test_work<PATTERN_217153>(nDepth);
 
-                lk.unlock();
-                have_work = true;
-            }
+            default:
+                return test_work<PATTERN_GENERIC>(nDepth);
         }
+    }
 
-        /* Return (and wait a little) if we don't have work. */
-        if (!have_work || fReset.load())
-            return false;
 
-        /* Set the block. */
-        block = work.block;
+    template<uint32_t nPattern>
+    bool PrimeTestCPU::test_work(uint32_t nDepth)
+    {
+        typedef offset_pattern<nPattern> pattern;
 
-        uint1024_t nChainEnd = 0;
-        uint1024_t nPrimeOrigin = block.ProofHash();
         uint64_t nNonce = 0;
         uint64_t offset = 0;
         uint32_t combo = 0;
-        uint32_t nHeight = block.nHeight;
-        uint32_t nWorkCount = (uint32_t)work.nonce_offsets.size();
+        uint32_t nWorkCount = 0;
         uint32_t nPrimeDifficulty = 0;
-        uint32_t nPrimeDifficulty2 = 0;
 
-        /* Get the begin and end offsets of the chain. */
-        uint32_t chain_offset_beg = 0;
-        uint32_t chain_offset_end = 0;
+        /* The longest chain a candidate can still make, and the chain it must be able
+           to reach to be worth testing: the block target or the configured minimum. */
+        uint32_t nChainBound = 0;
+        uint32_t nChainMin = std::min(nMinChain, block.nBits / 10000000);
 
-        /* Get the number of survived offsets. */
+        /* Get the number of primes in the chain. */
         uint32_t chain_length = 0;
 
 
         uint32_t i = 0;
         uint8_t j = 0;
-        uint8_t nOffsets = vOffsets.size();
-        uint8_t nPrimeGap = 0;
-
-        /* Get the prime origin from the block and import into GMP. */
-        mpz_import(zPrimeOrigin, 32, -1, sizeof(uint32_t), 0, 0, nPrimeOrigin.begin());
-
-        /* Compute the primorial mod from the origin. */
-        mpz_mod(zPrimorialMod, zPrimeOrigin, zPrimorial);
-        mpz_sub(zPrimorialMod, zPrimorial, zPrimorialMod);
-        mpz_add(zBaseOrigin, zPrimeOrigin, zPrimorialMod);
+        uint8_t nOffsets = pattern::size();
+        uint32_t nOffsetMask = 0xFFFFFFFF >> (32 - nOffsets);
+        uint32_t nSurvivors = 0;
+        uint32_t nUntested = 0;
+        uint32_t nOffset = 0;
+        uint32_t nTrial = 0;
+        uint32_t nPreTest = 0;
+        uint32_t nLevel = 0;
+
+        /* The size of a batch of gap numbers, and where the gap of each candidate goes on. */
+        uint32_t vGapNext[WORK_CHUNK_SIZE];
+        uint32_t nBatch = 0;
+        uint32_t k = 0;
+
+        /* The runs of survivors a chain is built from, and the longest closed run of
+           each candidate whose chain is still open. */
+        uint32_t vChainRun[WORK_CHUNK_SIZE];
+        uint32_t nRun = 0;
+        uint32_t nBest = 0;
+        uint32_t t = 0;
+
+        nWorkCount = (uint32_t)work.nonce_offsets.size();
 
 
         /* Log message. */
         debug::log(3, "PrimeTestCPU[", (uint32_t)nID, "]: ", nWorkCount, " nonces from ", (uint32_t)work.thr_id);
 
-        /* Process each result from array of nonces. */
+
+        /* Set up the candidates with the offsets the sieve left for them to test. */
+        nCandidates = 0;
         for(i = 0; i < nWorkCount; ++i)
         {
-            if(fReset.load() || nHeight != block.nHeight)
-                return false;
+            test_candidate &candidate = vCandidates[nCandidates];
 
             /* Obtain work nonce offset and nonce meta. */
             offset = work.nonce_offsets[i];
             combo = work.nonce_meta[i];
 
-            /* Compute the base offset of the nonce */
-            mpz_add_ui(zBaseOffsetted, zBaseOrigin, offset);
+            candidate.offset = offset;
+            candidate.nSurvivors = 0;
+            candidate.nUntested = 0;
+            candidate.nTrial = nCandidates;
 
             if(combo)
             {
-                /* Mask off high and low 1-bits not set by gpu sieve */
+                /* Mask off high and low 1-bits not set by the combo sieve */
                 combo = (combo >> gpu_begin) << gpu_begin;
                 combo = (combo << (32 - gpu_end)) >> (32 - gpu_end);
                 //debug::log(0, " gpu combo=", std::bitset<32>(combo));
 
-                /* Loop through combo and test remaining offsets. */
-                for(j = 0; j < nOffsets; ++j)
-                {
-                    /* Skip GPU offsets. Already Fermat tested. */
-                    if(mapTest.find(j) != mapTest.end())
-                        continue;
+                nSurvivors = ~combo & nOffsetMask;
 
-                    /* Don't test failed sieved offsets. */
-                    if(combo & (1 << j))
-                        continue;
+                /* Don't test a candidate the sieve already left too short a chain. */
+                if(chain_bound<nPattern>(nSurvivors) < nChainMin)
+                    continue;
 
-                    /* Start fresh from each offset remaining. */
-                    mpz_add_ui(zTempVar, zBaseOffsetted, vOffsets[j]);
+                candidate.combo = work.nonce_meta[i];
+                candidate.nSurvivors = nSurvivors;
 
-                    /* Check for Fermat test. */
-                    mpz_sub_ui(zN, zTempVar, 1);
-                    mpz_powm(zResidue, zTwo, zN, zTempVar);
-                    if (mpz_cmp_ui(zResidue, 1) == 0)
-                        ++PrimesFound[j];
-                    else
-                        combo |= (1 << j);
+                /* Skip offsets the producer already Fermat tested. */
+                candidate.nUntested = nSurvivors & ~work.tested_mask;
+            }
+            else
+                candidate.combo = 0;
 
+            ++nCandidates;
+        }
 
-                    ++PrimesChecked[j];
-                    ++Tests_CPU;
-                }
 
+        /* Nonces from the CPU sieve haven't had any offsets tested yet. Pretest them here,
+           one leading offset at a time, with more the deeper the queue has backed up. */
+        if(work.tested_mask == 0)
+        {
+            nPreTest = std::min(std::max(nDepth, nPreTestMin), nPreTestMax);
+            nPreTest = std::min(nPreTest, pattern::sizeA());
 
+            for(k = 0; k < nPreTest; ++k)
+            {
+                if(!test_level<nPattern>(1 << pattern::indexA(k), 1 << pattern::indexA(k), nChainMin))
+                    return false;
+            }
 
-                /* Invert the bits and mask off the high bits. */
-                combo = (~combo) & (0xFFFFFFFF >> nOffsets);
+            debug::log(3, "PrimeTestCPU[", (uint32_t)nID, "]: pretest ", nPreTest, " offsets kept ", nCandidates, "/", nWorkCount);
+        }
 
-                /* If there are no more combo bits, this candidate will never lead to a solution. */
-                if(combo == 0)
-                    continue;
 
-                /* Get the begin and end offsets of the chain. */
-                chain_offset_beg = convert::ctz(combo);
-                chain_offset_end = nOffsets - convert::clz(combo << (32 - 1 - nOffsets));
+        /* Don't test offsets the sieve didn't cover that have a small factor. The residues
+           are only set up for the candidates the pretest kept, once for the work item,
+           and the trial division and the gap search add the offsets to them. */
+        for(i = 0; i < nCandidates; ++i)
+        {
+            test_candidate &candidate = vCandidates[i];
 
-                /* Get the number of survived offsets. */
-                chain_length = convert::popc(combo);
-            }
-            else
+            trial_residues(candidate.nTrial, candidate.offset);
+
+            for(nSurvivors = candidate.nUntested & ~nSievedMask; nSurvivors; nSurvivors &= (nSurvivors - 1))
             {
-                chain_offset_beg = 0;
-                chain_offset_end = 0;
-                chain_length = 1;
+                j = convert::ctz(nSurvivors);
+
+                if(trial_composite(candidate.nTrial, pattern::offset(j)))
+                {
+                    candidate.nSurvivors &= ~(1 << j);
+                    candidate.nUntested &= ~(1 << j);
+                }
             }
+        }
+
+
+        /* Test the remaining offsets breadth first. The first levels test the lowest
+           offset any candidate has left, compacting the candidates between them, and
+           the last level tests all that is left together. */
+        for(nLevel = 1; ; ++nLevel)
+        {
+            nUntested = 0;
+            for(i = 0; i < nCandidates; ++i)
+                nUntested |= vCandidates[i].nUntested;
+
+            if(nUntested == 0)
+                break;
+
+            if(nLevel < nTestLevels)
+                nUntested &= (0 - nUntested);
+
+            /* Candidates without primes left can't make a chain at all. */
+            if(!test_level<nPattern>(nUntested, 0, std::max(nChainMin, 1u)))
+                return false;
+        }
 
-            //if(chain_length >= 3)
-            //    debug::log(0, "combo=", std::bitset<32>(combo), " len=", chain_length, " beg=", chain_offset_beg,
-            //               " end=", chain_offset_end);
 
+        /* Build the chains of the candidates that are left from their runs of survivors. */
+        for(i = 0; i < nCandidates; ++i)
+        {
+            const test_candidate &candidate = vCandidates[i];
+            chain_info &chain = vChains[i];
 
-            if(chain_offset_beg > chain_offset_end)
-                return debug::error("Offset begin greater than end.",
-                " beg=", chain_offset_beg,
-                " end=", chain_offset_end);
+            vGapNext[i] = 0;
+            vChainRun[i] = 0;
 
-            if(chain_offset_beg >= nOffsets || chain_offset_end >= nOffsets)
+            if(candidate.combo)
             {
-                return debug::error("Offset index out of bounds.",
-                " beg=", chain_offset_beg,
-                " end=", chain_offset_end,
-                " combo=", std::bitset<32>(combo));
+                nChainBound = chain_bound<nPattern>(candidate.nSurvivors);
+
+                /* Split the survivors into runs at each gap that is too wide, keeping the
+                   longest closed run and the run still open at the top. */
+                nRun = 0;
+                nBest = 0;
+                for(nSurvivors = candidate.nSurvivors; nSurvivors; nSurvivors &= (nSurvivors - 1))
+                {
+                    j = convert::ctz(nSurvivors);
+
+                    if(nRun && pattern::offset(j) - pattern::offset(t) > CHAIN_GAP_MAX)
+                    {
+                        if(convert::popc(nRun) > convert::popc(nBest))
+                            nBest = nRun;
+
+                        nRun = 0;
+                    }
+
+                    nRun |= 1 << j;
+                    t = j;
+                }
+
+                /* The gap search can still grow a run that reaches the last offset, so its chain
+                   is built first, and the longest closed run is kept in case it stays longer. */
+                if(nChainBound == CHAIN_UNBOUNDED)
+                    vChainRun[i] = nBest;
+                else if(convert::popc(nBest) > convert::popc(nRun))
+                    nRun = nBest;
+
+                chain_run<nPattern>(chain, nRun);
+            }
+            else
+            {
+                nChainBound = CHAIN_UNBOUNDED;
+                chain.reset(pattern::offset(0));
             }
 
+            /* Search for primes after the small cluster, if the chain runs into the gap past the last offset. */
+            if(nChainBound == CHAIN_UNBOUNDED)
+                vGapNext[i] = chain.last() + 2;
+        }
 
-            chain_offset_beg = vOffsets[chain_offset_beg];
-            chain_offset_end = vOffsets[chain_offset_end] + 2;
 
+        /* Search the gaps of all candidates together, in rounds. Each round gathers
+           the numbers of every open gap up to its end, which is as far as the search
+           goes unless a prime is found, and tests them in dense batches across the
+           candidates. A prime moves the end of its gap on for the next round. The
+           gaps were never sieved, so numbers with a small factor are left out. The
+           composite that ends a chain is tested along with the gap, for its residue. */
+        for(bool fOpen = true; fOpen; )
+        {
+            fOpen = false;
+            nBatch = 0;
 
-            /* Search for primes after small cluster */
-            nPrimeGap = 0;
-            mpz_add_ui(zTempVar, zBaseOffsetted, chain_offset_end);
-            while (nPrimeGap <= 12)
+            for(i = 0; i < nCandidates; ++i)
             {
-                if(fReset.load() || nHeight != block.nHeight)
-                    return false;
+                if(vGapNext[i] == 0 || vGapNext[i] > vChains[i].end())
+                    continue;
 
+                offset = vCandidates[i].offset;
+                nTrial = vCandidates[i].nTrial;
 
-                mpz_sub_ui(zN, zTempVar, 1);
-                mpz_powm(zResidue, zTwo, zN, zTempVar);
-                if (mpz_cmp_ui(zResidue, 1) == 0)
+                /* A batch that fills up mid gap is tested right away, which can move the end on. */
+                for(nOffset = vGapNext[i]; nOffset <= vChains[i].end(); nOffset += 2)
                 {
-                    //++PrimesFound;
-                    ++chain_length;
+                    if(trial_composite(nTrial, nOffset))
+                        continue;
 
-                    nPrimeGap = 0;
-                }
+                    mpz_add_ui(zBatch[nBatch], context->zBaseOrigin, offset + nOffset);
+                    vBatchCandidates[nBatch] = i;
+                    vBatchOffsets[nBatch++] = nOffset;
+
+                    if(nBatch == FERMAT_BATCH_MAX)
+                    {
+                        if(!test_gaps(nBatch))
+                            return false;
 
-                //++PrimesChecked;
-                ++Tests_CPU;
+                        nBatch = 0;
+                    }
+                }
 
-                mpz_add_ui(zTempVar, zTempVar, 2);
-                chain_offset_end += 2;
-                nPrimeGap += 2;
+                vGapNext[i] = nOffset;
             }
 
+            if(nBatch && !test_gaps(nBatch))
+                return false;
+
+            for(i = 0; i < nCandidates; ++i)
+                fOpen |= (vGapNext[i] != 0 && vGapNext[i] <= vChains[i].end());
+        }
+
+
+        /* Report the chains of the candidates. */
+        for(i = 0; i < nCandidates; ++i)
+        {
+            if(fReset.load() || g_work_queue.stale(work))
+                return false;
+
+            chain_info &chain = vChains[i];
+
+            /* A closed run lower down can still be longer than the chain the gap search grew. */
+            if(convert::popc(vChainRun[i]) > chain.length())
+                chain_run<nPattern>(chain, vChainRun[i]);
+
+            offset = vCandidates[i].offset;
+            combo = vCandidates[i].nSurvivors;
+
+            /* Compute the base offset of the nonce */
+            mpz_add_ui(zBaseOffsetted, context->zBaseOrigin, offset);
+
+            chain_length = chain.length();
+
 
             /* Translate nonce offset of begin prime to global offset. */
-            mpz_add_ui(zTempVar, zBaseOffsetted, chain_offset_beg);
-            mpz_sub(zTempVar, zTempVar, zPrimeOrigin);
+            mpz_add_ui(zTempVar, zBaseOffsetted, chain.begin());
+            mpz_sub(zTempVar, zTempVar, context->zPrimeOrigin);
             nNonce = mpz_get_ui(zTempVar);
 
-            if(fReset.load() || nHeight != block.nHeight)
+            if(fReset.load() || g_work_queue.stale(work))
                 return false;
 
 
             if (chain_length >= 3)
             {
-                nChainEnd = nPrimeOrigin + nNonce + chain_offset_end;
-
-                nPrimeDifficulty = SetBits(GetPrimeDifficulty(nChainEnd, chain_length));
-
-                nPrimeDifficulty2 = GetPrimeBits(CBigNum(nPrimeOrigin + nNonce));
-
-                if(nPrimeDifficulty != nPrimeDifficulty2)
-                {
-                    //debug::error("Mismatch, GMP: ", nPrimeDifficulty, "  OpenSSL: ", nPrimeDifficulty2);
-                    nPrimeDifficulty = nPrimeDifficulty2;
-                    chain_length = (uint32_t)(nPrimeDifficulty2 / 1e7);
-                }
+                /* The fractional difficulty comes from the residue of the composite that ends the chain. */
+                nPrimeDifficulty = chain.difficulty(zBaseOffsetted);
 
                 /* Compute the weight for WPS. */
-                if(chain_length >= 3)
-                    nWeight += nPrimeDifficulty * 50;
+                nWeight += nPrimeDifficulty * 50;
 
 
                 if (nPrimeDifficulty > nLargest)
@@ -342,15 +471,12 @@ namespace LLC
                 }
 
 
-                /* Check Difficulty */
-                if (nPrimeDifficulty >= block.nBits && !fReset.load() && nHeight == block.nHeight)
+                /* Chains that reach the block difficulty are checked in full by the verifier before they are submitted. */
+                if (nPrimeDifficulty >= block.nBits && !fReset.load() && !g_work_queue.stale(work))
                 {
-                    debug::log(0, "[MASTER] Found Prime Block ", block.ProofHash().ToString().substr(0, 20), " with Difficulty ", std::fixed, std::setprecision(7), nPrimeDifficulty/1e7);
+                    debug::log(2, "PrimeTestCPU[", (uint32_t)nID, "]: ", chain_length, "-Chain with Difficulty ", std::fixed, std::setprecision(7), nPrimeDifficulty/1e7, " sent to verify");
 
-                    /* Set the block nonce and return. */
-                    block.nNonce = nNonce;
-                    fReset = true;
-                    return true;
+                    g_verify_queue.push(verify_info(work.block, nNonce, nPrimeDifficulty, work.thr_id, work.epoch));
                 }
             }
 
@@ -360,6 +486,192 @@ namespace LLC
     }
 
 
+    template<uint32_t nPattern>
+    bool PrimeTestCPU::test_level(uint32_t nLevelMask, uint32_t nRequired, uint32_t nChainMin)
+    {
+        typedef offset_pattern<nPattern> pattern;
+
+        uint32_t nBatch = 0;
+        uint32_t nKept = 0;
+        uint32_t i = 0;
+
+        /* Gather the numbers of the level from all candidates, testing a batch whenever it fills up. */
+        for(i = 0; i < nCandidates; ++i)
+        {
+            for(uint32_t nTest = vCandidates[i].nUntested & nLevelMask; nTest; nTest &= (nTest - 1))
+            {
+                uint32_t j = convert::ctz(nTest);
+
+                mpz_add_ui(zBatch[nBatch], context->zBaseOrigin, vCandidates[i].offset + pattern::offset(j));
+                vBatchCandidates[nBatch] = i;
+                vBatchOffsets[nBatch++] = j;
+
+                if(nBatch == FERMAT_BATCH_MAX)
+                {
+                    if(!test_batch(nBatch))
+                        return false;
+
+                    nBatch = 0;
+                }
+            }
+        }
+
+        if(nBatch && !test_batch(nBatch))
+            return false;
+
+        /* Compact the candidates that can still make a useful chain. Candidates
+           without sieve meta have nothing to test and are always kept. */
+        for(i = 0; i < nCandidates; ++i)
+        {
+            const test_candidate &candidate = vCandidates[i];
+
+            if(candidate.combo)
+            {
+                if((candidate.nSurvivors & nRequired) != nRequired)
+                    continue;
+
+                if(chain_bound<nPattern>(candidate.nSurvivors) < nChainMin)
+                    continue;
+            }
+
+            vCandidates[nKept++] = candidate;
+        }
+
+        nCandidates = nKept;
+
+        return true;
+    }
+
+
+    bool PrimeTestCPU::test_gaps(uint32_t nBatch)
+    {
+        if(fReset.load() || g_work_queue.stale(work))
+            return false;
+
+        uint32_t nPrimes = FermatPrimes(zBatch, nBatch, zResidues);
+
+        for(uint32_t k = 0; k < nBatch; ++k)
+        {
+            chain_info &chain = vChains[vBatchCandidates[k]];
+            uint32_t nOffset = vBatchOffsets[k];
+
+            if((nPrimes & (1 << k)) && nOffset - chain.last() <= CHAIN_GAP_MAX)
+                chain.extend(nOffset);
+            else
+                chain.keep(nOffset, zResidues[k]);
+
+            ++Tests_CPU;
+        }
+
+        return true;
+    }
+
+
+    bool PrimeTestCPU::test_batch(uint32_t nBatch)
+    {
+        if(fReset.load() || g_work_queue.stale(work))
+            return false;
+
+        uint32_t nPrimes = FermatPrimes(zBatch, nBatch);
+
+        for(uint32_t k = 0; k < nBatch; ++k)
+        {
+            test_candidate &candidate = vCandidates[vBatchCandidates[k]];
+            uint32_t j = vBatchOffsets[k];
+
+            if(nPrimes & (1 << k))
+                ++PrimesFound[j];
+            else
+                candidate.nSurvivors &= ~(1 << j);
+
+            candidate.nUntested &= ~(1 << j);
+
+            ++PrimesChecked[j];
+            ++Tests_CPU;
+        }
+
+        return true;
+    }
+
+
+    template<uint32_t nPattern>
+    void PrimeTestCPU::chain_run(chain_info &chain, uint32_t nRun)
+    {
+        typedef offset_pattern<nPattern> pattern;
+
+        chain.reset(pattern::offset(convert::ctz(nRun)));
+
+        for(nRun &= (nRun - 1); nRun; nRun &= (nRun - 1))
+            chain.extend(pattern::offset(convert::ctz(nRun)));
+    }
+
+
+    template<uint32_t nPattern>
+    constexpr uint32_t PrimeTestCPU::chain_bound(uint32_t nSurvivors, uint32_t n, uint32_t t, uint32_t nRun, uint32_t nBest)
+    {
+        typedef offset_pattern<nPattern> pattern;
+
+        /* Numbers between the offsets are composite, but past the last one the open run can go on. */
+        return n == pattern::size()
+            ? (nRun && pattern::offset(t) + CHAIN_GAP_MAX > pattern::offset(n - 1) ? CHAIN_UNBOUNDED : nBest)
+
+            : (nSurvivors & (1u << n)) == 0
+            ? chain_bound<nPattern>(nSurvivors, n + 1, t, nRun, nBest)
+
+            /* A gap that is too wide starts a new run at this survivor. */
+            : nRun && pattern::offset(n) - pattern::offset(t) > CHAIN_GAP_MAX
+            ? chain_bound<nPattern>(nSurvivors, n + 1, n, 1, nBest ? nBest : 1)
+
+            : chain_bound<nPattern>(nSurvivors, n + 1, n, nRun + 1, nRun + 1 > nBest ? nRun + 1 : nBest);
+    }
+
+
+    /* The longest run counts wherever it is, not just from the lowest survivor. */
+    static_assert(PrimeTestCPU::chain_bound<PATTERN_217153>(0x00000007) == 3, "chain_bound: run from the first offset");
+    static_assert(PrimeTestCPU::chain_bound<PATTERN_217153>(0x00001FC1) == 7, "chain_bound: isolated first survivor");
+    static_assert(PrimeTestCPU::chain_bound<PATTERN_217153>(0x00001FC7) == 7, "chain_bound: longer run after a short one");
+    static_assert(PrimeTestCPU::chain_bound<PATTERN_217153>(0x00070001) == CHAIN_UNBOUNDED, "chain_bound: run into the last gap");
+    static_assert(PrimeTestCPU::chain_bound<PATTERN_217153>(0) == 0, "chain_bound: no survivors");
+
+
+    void PrimeTestCPU::trial_residues(uint32_t nTrial, uint64_t offset)
+    {
+        const uint32_t *pPrimes = context->vTrialPrimes.data();
+        const uint64_t *pRecip = context->vTrialRecip.data();
+        const uint32_t *pBase = context->vTrialBase.data();
+        uint32_t *pTrial = &vTrial[nTrial * TEST_TRIAL_PRIMES];
+        uint32_t nPrimes = context->vTrialPrimes.size();
+
+        for(uint32_t i = 0; i < nPrimes; ++i)
+            pTrial[i] = mod_p_small(offset + pBase[i], pPrimes[i], pRecip[i]);
+    }
+
+
+    bool PrimeTestCPU::trial_composite(uint32_t nTrial, uint32_t nOffset)
+    {
+        const uint32_t *pInverse = context->vTrialInverse.data();
+        const uint32_t *pLimit = context->vTrialLimit.data();
+        const uint32_t *pTrial = &vTrial[nTrial * TEST_TRIAL_PRIMES];
+        uint32_t nPrimes = context->vTrialPrimes.size();
+        uint32_t nFactor = 0;
+
+        /* A number divides by an odd prime if its product with the inverse is at most the largest quotient. */
+        for(uint32_t i = 0; i < nPrimes; ++i)
+            nFactor |= ((pTrial[i] + nOffset) * pInverse[i] <= pLimit[i]);
+
+        return nFactor != 0;
+    }
+
+
+    void PrimeTestCPU::Reset()
+    {
+        Proof::Reset();
+
+        /* Wake up the test workers blocked on the work queue. */
+        g_work_queue.wake();
+    }
+
+
     void PrimeTestCPU::Shutdown()
     {
         debug::log(3, FUNCTION, "PrimeTestCPU", static_cast<uint32_t>(nID));
@@ -368,12 +680,15 @@ namespace LLC
         fReset = true;
 
         mpz_clear(zTempVar);
-        mpz_clear(zN);
         mpz_clear(zBaseOffsetted);
-        mpz_clear(zBaseOrigin);
-        mpz_clear(zPrimeOrigin);
-        mpz_clear(zResidue);
-        mpz_clear(zPrimorialMod);
+
+        context.reset();
+
+        for(uint32_t i = 0; i < FERMAT_BATCH_MAX; ++i)
+        {
+            mpz_clear(zBatch[i]);
+            mpz_clear(zResidues[i]);
+        }
     }
 
 }
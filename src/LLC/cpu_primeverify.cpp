@@ -0,0 +1,108 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/include/global.h>
+#include <LLC/types/cpu_primeverify.h>
+#include <LLC/prime/prime.h>
+
+#include <TAO/Ledger/types/block.h>
+
+#include <Util/include/debug.h>
+
+#include <iomanip>
+
+namespace LLC
+{
+
+    PrimeVerifyCPU::PrimeVerifyCPU(uint32_t id)
+    : Proof(id)
+    , info()
+    {
+    }
+
+
+    PrimeVerifyCPU::~PrimeVerifyCPU()
+    {
+    }
+
+
+    void PrimeVerifyCPU::Load()
+    {
+        debug::log(3, FUNCTION, "PrimeVerifyCPU", static_cast<uint32_t>(nID));
+    }
+
+
+    void PrimeVerifyCPU::Init()
+    {
+        debug::log(3, FUNCTION, "PrimeVerifyCPU", static_cast<uint32_t>(nID));
+
+        /* Atomic set reset flag to false. */
+        fReset = false;
+    }
+
+
+    bool PrimeVerifyCPU::Work()
+    {
+        if(fReset.load())
+            return false;
+
+        /* Wait for a chain from the test workers. */
+        if(!g_verify_queue.pop(info, fReset))
+            return false;
+
+        /* Drop chains of an older round. */
+        if(info.epoch != g_work_queue.epoch())
+            return false;
+
+        /* Set the block. */
+        block = *info.block;
+
+        /* Check every prime of the chain again, with OpenSSL. */
+        uint32_t nPrimeDifficulty = GetPrimeBits(CBigNum(block.ProofHash() + info.nonce));
+
+        if(nPrimeDifficulty != info.difficulty)
+            debug::error("Mismatch, GMP: ", info.difficulty, "  OpenSSL: ", nPrimeDifficulty);
+
+        /* Check Difficulty */
+        if(nPrimeDifficulty >= block.nBits && !fReset.load() && info.epoch == g_work_queue.epoch())
+        {
+            debug::log(0, "[MASTER] Found Prime Block ", block.ProofHash().ToString().substr(0, 20), " with Difficulty ", std::fixed, std::setprecision(7), nPrimeDifficulty/1e7);
+
+            /* Set the block nonce and return. */
+            block.nNonce = info.nonce;
+            fReset = true;
+            return true;
+        }
+
+        return false;
+    }
+
+
+    void PrimeVerifyCPU::Reset()
+    {
+        Proof::Reset();
+
+        /* Wake up the verifier blocked on the verify queue. */
+        g_verify_queue.wake();
+    }
+
+
+    void PrimeVerifyCPU::Shutdown()
+    {
+        debug::log(3, FUNCTION, "PrimeVerifyCPU", static_cast<uint32_t>(nID));
+
+        /* Atomic set reset flag to true. */
+        fReset = true;
+    }
+
+}
@@ -59,6 +59,7 @@ namespace LLC
     , nPrimeLimitA(4096)
     , nPrimeLimitB(564164)
     , nTestLevel(0)
+    , nEpoch(0)
     {
         for(uint8_t i = 0; i < OFFSETS_MAX; ++i)
         {
@@ -139,6 +140,9 @@ namespace LLC
         /* Set the GPU quit flag to false. */
         cuda_set_quit(0);
 
+        /* Tag the work of this block with the current round. */
+        nEpoch = g_work_queue.epoch();
+
         /* Initialize the stats for this CPU. */
         nCount = 0;
         nSieveIndex = 0;
@@ -339,11 +343,13 @@ namespace LLC
                 work_meta.push_back(it->second);
             }
 
-            {
-                /* Atomic add nonces to work queue for testing. */
-                std::unique_lock<std::mutex> lk(g_work_mutex);
-                g_work_queue.emplace_back(work_info(work_offsets, work_meta, block, nID));
-            }
+            /* The test offsets were already Fermat tested on the GPU. */
+            uint32_t nTested = 0;
+            for(uint32_t i = 0; i < vOffsetsT.size(); ++i)
+                nTested |= 1 << vOffsetsT[i];
+
+            /* Add nonces to work queue for testing, waking up a test worker. */
+            g_work_queue.push(work_info(work_offsets, work_meta, block, nID, nTested, nEpoch));
 
             count = 0;
         }
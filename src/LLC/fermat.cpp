@@ -0,0 +1,766 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/prime/fermat.h>
+#include <LLC/prime/montgomery.h>
+#include <Util/include/debug.h>
+#include <Util/include/runtime.h>
+#include <Util/include/bitmanip.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+/* Batches in the 64-bit lanes of AVX-512 with the 52-bit multiply-add of IFMA. */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FERMAT_IFMA
+#include <immintrin.h>
+#endif
+
+/* The numbers tested at once, one in each lane of a vector. */
+#define FERMAT_IFMA_LANES 8
+
+/* The most 52-bit limbs in a lane, for moduli of up to FERMAT_LIMBS_MAX 64-bit limbs. */
+#define FERMAT_IFMA_LIMBS 21
+
+/* The fewest numbers worth filling a vector for, fewer are tested one at a time. */
+#define FERMAT_IFMA_MIN 3
+
+/* The lane widths, by groups of four 52-bit limbs. */
+#define FERMAT_IFMA_WIDTHS 6
+
+/* The full vectors of each width also timed with mpz_powm, before the faster one is kept. */
+#define FERMAT_IFMA_CALIBRATE 4
+
+/* The single numbers of each limb count also timed with mpz_powm, before the faster one is kept. */
+#define FERMAT_ENGINE_CALIBRATE 16
+
+namespace LLC
+{
+
+    /** fermat_scratch
+     *
+     *  The GMP temporaries of the Fermat tests of a thread, allocated once and
+     *  grown to the size of the numbers, so the tests themselves don't allocate.
+     *
+     **/
+    struct fermat_scratch
+    {
+        mpz_t zE;
+        mpz_t zT;
+        mpz_t zR;
+
+        fermat_scratch()
+        {
+            mpz_init(zE);
+            mpz_init(zT);
+            mpz_init(zR);
+        }
+
+        ~fermat_scratch()
+        {
+            mpz_clear(zE);
+            mpz_clear(zT);
+            mpz_clear(zR);
+        }
+    };
+
+    static thread_local fermat_scratch scratch;
+
+
+    /* Test a single number with mpz_powm. If a residue is asked for, keep it. */
+    static bool fermat_powm(mpz_srcptr zN, mpz_ptr zR)
+    {
+        mpz_sub_ui(scratch.zE, zN, 1);
+        mpz_set_ui(scratch.zT, 2);
+        mpz_powm(scratch.zT, scratch.zT, scratch.zE, zN);
+        bool fPrime = (mpz_cmp_ui(scratch.zT, 1) == 0);
+
+        /* Swap the limbs over, which leaves the scratch with those of the residue. */
+        if(zR)
+            mpz_swap(zR, scratch.zT);
+
+        return fPrime;
+    }
+
+
+    /* Check if the fixed width engine and the lanes cover a number. Montgomery form needs an odd modulus. */
+    static bool fermat_fits(mpz_srcptr zN)
+    {
+    #if GMP_LIMB_BITS == 64
+        return mpz_sgn(zN) > 0 && mpz_odd_p(zN) && mpz_cmp_ui(zN, 1) != 0 && mpz_size(zN) <= FERMAT_LIMBS_MAX;
+    #else
+        return false;
+    #endif
+    }
+
+
+    /* Run the fixed width engine for a modulus of N limbs. If a residue is
+       asked for, compute it instead of only checking it for 1. */
+    template<uint32_t N>
+    static bool fermat_limbs(const mp_limb_t *pLimbs, mpz_ptr zR)
+    {
+        montgomery<N> mont(pLimbs);
+
+        if(!zR)
+            return mont.fermat();
+
+        mont.residue(mpz_limbs_write(zR, N));
+        mpz_limbs_finish(zR, N);
+
+        return mpz_cmp_ui(zR, 1) == 0;
+    }
+
+
+    /* Run the engine fixed to the limb count of the number. */
+    static bool fermat_engine(mpz_srcptr zN, mpz_ptr zR)
+    {
+        const mp_limb_t *pLimbs = mpz_limbs_read(zN);
+
+        switch(mpz_size(zN))
+        {
+            case  1: return fermat_limbs<1>(pLimbs, zR);
+            case  2: return fermat_limbs<2>(pLimbs, zR);
+            case  3: return fermat_limbs<3>(pLimbs, zR);
+            case  4: return fermat_limbs<4>(pLimbs, zR);
+            case  5: return fermat_limbs<5>(pLimbs, zR);
+            case  6: return fermat_limbs<6>(pLimbs, zR);
+            case  7: return fermat_limbs<7>(pLimbs, zR);
+            case  8: return fermat_limbs<8>(pLimbs, zR);
+            case  9: return fermat_limbs<9>(pLimbs, zR);
+            case 10: return fermat_limbs<10>(pLimbs, zR);
+            case 11: return fermat_limbs<11>(pLimbs, zR);
+            case 12: return fermat_limbs<12>(pLimbs, zR);
+            case 13: return fermat_limbs<13>(pLimbs, zR);
+            case 14: return fermat_limbs<14>(pLimbs, zR);
+            case 15: return fermat_limbs<15>(pLimbs, zR);
+            case 16: return fermat_limbs<16>(pLimbs, zR);
+            default: return fermat_limbs<17>(pLimbs, zR);
+        }
+    }
+
+
+    static std::mutex CALIBRATE_MUTEX;
+
+    /* Whether the engine of each limb count measured faster than mpz_powm: zero
+       while it is being timed, then one if it did or minus one if not. */
+    static std::atomic<int32_t> vEngineFaster[FERMAT_LIMBS_MAX + 1];
+
+    static uint64_t vEngineTime[FERMAT_LIMBS_MAX + 1];
+    static uint64_t vEnginePowmTime[FERMAT_LIMBS_MAX + 1];
+    static uint32_t vEngineCalibrated[FERMAT_LIMBS_MAX + 1];
+    static bool vEngineMismatch[FERMAT_LIMBS_MAX + 1];
+
+
+    /* Test a number with the engine, and time it against mpz_powm on the same
+       number, until there are enough timings to tell which one is faster. Any
+       result that differs from mpz_powm keeps the engine off for good. */
+    static bool fermat_engine_calibrate(mpz_srcptr zN, mpz_ptr zR)
+    {
+        runtime::timer timer;
+        uint32_t nSize = mpz_size(zN);
+
+        timer.Start();
+        bool fEngine = fermat_engine(zN, zR);
+        uint64_t nEngine = timer.ElapsedNanoseconds();
+
+        timer.Start();
+        bool fPrime = fermat_powm(zN, scratch.zR);
+        uint64_t nPowm = timer.ElapsedNanoseconds();
+
+        bool fMismatch = (fEngine != fPrime) || (zR && mpz_cmp(zR, scratch.zR) != 0);
+        if(fMismatch)
+            debug::error(FUNCTION, "engine of ", nSize, " limbs differs from mpz_powm");
+
+        /* Hand out the result of mpz_powm, the reference. */
+        if(zR)
+            mpz_swap(zR, scratch.zR);
+
+        std::unique_lock<std::mutex> lk(CALIBRATE_MUTEX);
+
+        /* The first number of a limb count warms up the caches and scratch, so it isn't timed. */
+        if(vEngineCalibrated[nSize] > 0)
+        {
+            vEngineTime[nSize] += nEngine;
+            vEnginePowmTime[nSize] += nPowm;
+        }
+
+        vEngineMismatch[nSize] |= fMismatch;
+
+        if(vEngineMismatch[nSize])
+            vEngineFaster[nSize] = -1;
+        else if(++vEngineCalibrated[nSize] == FERMAT_ENGINE_CALIBRATE && vEngineFaster[nSize].load() == 0)
+        {
+            bool fFaster = vEngineTime[nSize] < vEnginePowmTime[nSize];
+
+            vEngineFaster[nSize] = fFaster ? 1 : -1;
+
+            debug::log(2, FUNCTION, "engine of ", nSize, " limbs runs ", std::fixed, std::setprecision(2),
+                (double)vEnginePowmTime[nSize] / std::max(vEngineTime[nSize], (uint64_t)1), "x mpz_powm, ",
+                fFaster ? "using it" : "using mpz_powm");
+        }
+
+        return fPrime;
+    }
+
+
+    /* Test a single number with the fixed width engine where it measured faster
+       than mpz_powm for its limb count, and with mpz_powm everywhere else. */
+    static bool fermat_test(mpz_srcptr zN, mpz_ptr zR)
+    {
+        if(fermat_fits(zN))
+        {
+            int32_t nFaster = vEngineFaster[mpz_size(zN)].load();
+
+            if(nFaster > 0)
+                return fermat_engine(zN, zR);
+
+            if(nFaster == 0)
+                return fermat_engine_calibrate(zN, zR);
+        }
+
+        return fermat_powm(zN, zR);
+    }
+
+
+    bool FermatPrime(const mpz_t zN)
+    {
+        return fermat_test(zN, nullptr);
+    }
+
+
+    void FermatResidue(mpz_t zR, const mpz_t zN)
+    {
+        fermat_test(zN, zR);
+    }
+
+
+#if defined(FERMAT_IFMA)
+
+    static const uint64_t MASK52 = (uint64_t(1) << 52) - 1;
+
+
+    /* Check the CPU for AVX-512 IFMA once. */
+    static bool has_ifma()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma");
+    }
+
+    static const bool fIFMA = has_ifma();
+
+
+    /* Split a number into L limbs of 52 bits, one lane apart. */
+    static void split52(mpz_srcptr zN, uint64_t *pLimbs, uint32_t L)
+    {
+        const mp_limb_t *p = mpz_limbs_read(zN);
+        uint32_t nSize = mpz_size(zN);
+
+        for(uint32_t j = 0; j < L; ++j)
+        {
+            uint32_t nBit = j * 52;
+            uint32_t i = nBit >> 6;
+            uint32_t nShift = nBit & 63;
+
+            uint64_t nLimb = (i < nSize) ? (p[i] >> nShift) : 0;
+            if(nShift > 12 && i + 1 < nSize)
+                nLimb |= p[i + 1] << (64 - nShift);
+
+            pLimbs[j * FERMAT_IFMA_LANES] = nLimb & MASK52;
+        }
+    }
+
+
+    /** ifma_mul
+     *
+     *  Montgomery multiplication of 8 lanes, r = a * b / 2^(52L) mod n. For inputs
+     *  below 4n and moduli below 2^(52L - 4) the result is below 2n, in 52-bit
+     *  limbs. The sums are kept unnormalized in 64-bit accumulators until the end.
+     *
+     **/
+    template<uint32_t L>
+    __attribute__((target("avx512f,avx512ifma")))
+    static inline void ifma_mul(__m512i *r, const __m512i *a, const __m512i *b, const __m512i *n, const __m512i nPrime)
+    {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i t[L + 1];
+        uint32_t i, j;
+
+        for(j = 0; j <= L; ++j)
+            t[j] = zero;
+
+        for(i = 0; i < L; ++i)
+        {
+            /* t += a * b[i] */
+            for(j = 0; j < L; ++j)
+            {
+                t[j] = _mm512_madd52lo_epu64(t[j], a[j], b[i]);
+                t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], a[j], b[i]);
+            }
+
+            /* t += m * n, with m chosen to clear the low 52 bits. */
+            __m512i m = _mm512_madd52lo_epu64(zero, t[0], nPrime);
+            for(j = 0; j < L; ++j)
+            {
+                t[j] = _mm512_madd52lo_epu64(t[j], n[j], m);
+                t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], n[j], m);
+            }
+
+            /* Shift down a limb, carrying the high bits of the cleared one. */
+            t[1] = _mm512_add_epi64(t[1], _mm512_srli_epi64(t[0], 52));
+            for(j = 0; j < L; ++j)
+                t[j] = t[j + 1];
+            t[L] = zero;
+        }
+
+        /* Normalize to 52-bit limbs. */
+        const __m512i mask = _mm512_set1_epi64(MASK52);
+        for(j = 0; j + 1 < L; ++j)
+        {
+            t[j + 1] = _mm512_add_epi64(t[j + 1], _mm512_srli_epi64(t[j], 52));
+            r[j] = _mm512_and_si512(t[j], mask);
+        }
+        r[L - 1] = t[L - 1];
+    }
+
+
+    /** ifma_dbl
+     *
+     *  Double the lanes set in the mask, without reducing. Inputs below 2n
+     *  stay below 4n, which the next multiplication takes.
+     *
+     **/
+    template<uint32_t L>
+    __attribute__((target("avx512f,avx512ifma")))
+    static inline void ifma_dbl(__m512i *x, __mmask8 nMask)
+    {
+        const __m512i mask = _mm512_set1_epi64(MASK52);
+        __m512i nCarry = _mm512_setzero_si512();
+
+        for(uint32_t j = 0; j < L; ++j)
+        {
+            __m512i y = _mm512_add_epi64(_mm512_slli_epi64(x[j], 1), nCarry);
+
+            nCarry = _mm512_srli_epi64(y, 52);
+            x[j] = _mm512_mask_blend_epi64(nMask, x[j], _mm512_and_si512(y, mask));
+        }
+    }
+
+
+    /** fermat_ifma
+     *
+     *  Base 2 Fermat test of up to 8 odd numbers below 2^(52L - 4), one in each
+     *  lane. Left to right over the bits of n - 1, each bit is a squaring and
+     *  the set bits double their lanes. Unused lanes repeat the first number.
+     *  If residues are asked for, the lanes are taken out of Montgomery form.
+     *
+     **/
+    template<uint32_t L>
+    __attribute__((target("avx512f,avx512ifma")))
+    static uint32_t fermat_ifma(const mpz_srcptr *pN, uint32_t nCount, mpz_ptr *pR)
+    {
+        alignas(64) uint64_t vModulus[L][FERMAT_IFMA_LANES];
+        alignas(64) uint64_t vOne[2][L][FERMAT_IFMA_LANES];
+        alignas(64) uint64_t vPrime[FERMAT_IFMA_LANES];
+        alignas(64) uint64_t vResult[L][FERMAT_IFMA_LANES];
+        uint64_t vExponent[FERMAT_IFMA_LANES][FERMAT_LIMBS_MAX];
+
+        __m512i n[L];
+        __m512i x[L];
+
+        uint32_t nLane, j;
+        int32_t nTop = 0;
+
+        mpz_ptr zT = scratch.zT;
+
+        for(nLane = 0; nLane < FERMAT_IFMA_LANES; ++nLane)
+        {
+            mpz_srcptr zN = pN[nLane < nCount ? nLane : 0];
+
+            split52(zN, &vModulus[0][nLane], L);
+            nTop = std::max(nTop, (int32_t)mpz_sizeinbase(zN, 2) - 1);
+
+            /* The exponent n - 1, the modulus is odd so only the low bit changes. */
+            const mp_limb_t *p = mpz_limbs_read(zN);
+            for(j = 0; j < FERMAT_LIMBS_MAX; ++j)
+                vExponent[nLane][j] = (j < mpz_size(zN)) ? p[j] : 0;
+            vExponent[nLane][0] &= ~uint64_t(1);
+
+            /* Newton iteration for -n^-1 mod 2^52. */
+            uint64_t n0 = p[0];
+            uint64_t nInverse = n0;
+            for(j = 0; j < 6; ++j)
+                nInverse *= 2 - n0 * nInverse;
+            vPrime[nLane] = (0 - nInverse) & MASK52;
+
+            /* One in Montgomery form, and one plus n since results are below 2n. */
+            mpz_set_ui(zT, 0);
+            mpz_setbit(zT, 52 * L);
+            mpz_mod(zT, zT, zN);
+            split52(zT, &vOne[0][0][nLane], L);
+
+            mpz_add(zT, zT, zN);
+            split52(zT, &vOne[1][0][nLane], L);
+        }
+
+        for(j = 0; j < L; ++j)
+        {
+            n[j] = _mm512_load_si512(vModulus[j]);
+            x[j] = _mm512_load_si512(vOne[0][j]);
+        }
+
+        const __m512i nPrime = _mm512_load_si512(vPrime);
+
+        /* Lanes with fewer bits square their one until their top bit comes up. */
+        for(int32_t nBit = nTop; nBit >= 0; --nBit)
+        {
+            __mmask8 nMask = 0;
+            for(nLane = 0; nLane < FERMAT_IFMA_LANES; ++nLane)
+                nMask |= ((vExponent[nLane][nBit >> 6] >> (nBit & 63)) & 1) << nLane;
+
+            ifma_mul<L>(x, x, x, n, nPrime);
+
+            if(nMask)
+                ifma_dbl<L>(x, nMask);
+        }
+
+        for(j = 0; j < L; ++j)
+            _mm512_store_si512(vResult[j], x[j]);
+
+        /* The last bit of n - 1 is clear, so the result is below 2n. It is
+           congruent to one when it is one or one plus n. */
+        uint32_t nPrimes = 0;
+        for(nLane = 0; nLane < nCount; ++nLane)
+        {
+            bool fOne = true;
+            bool fOneN = true;
+
+            for(j = 0; j < L; ++j)
+            {
+                fOne &= (vResult[j][nLane] == vOne[0][j][nLane]);
+                fOneN &= (vResult[j][nLane] == vOne[1][j][nLane]);
+            }
+
+            if(fOne || fOneN)
+                nPrimes |= 1 << nLane;
+        }
+
+        if(pR)
+        {
+            /* Multiply by 1 to divide by R, which leaves the residue below n + 1. */
+            __m512i b[L];
+
+            b[0] = _mm512_set1_epi64(1);
+            for(j = 1; j < L; ++j)
+                b[j] = _mm512_setzero_si512();
+
+            ifma_mul<L>(x, x, b, n, nPrime);
+
+            for(j = 0; j < L; ++j)
+                _mm512_store_si512(vResult[j], x[j]);
+
+            for(nLane = 0; nLane < nCount; ++nLane)
+            {
+                uint64_t vLimbs[L];
+                for(j = 0; j < L; ++j)
+                    vLimbs[j] = vResult[j][nLane];
+
+                /* The limbs are 52 bits, leaving 12 bits of nails at the top of each word. */
+                mpz_import(zT, L, -1, sizeof(uint64_t), 0, 12, vLimbs);
+                if(mpz_cmp(zT, pN[nLane]) >= 0)
+                    mpz_sub(zT, zT, pN[nLane]);
+
+                mpz_set(pR[nLane], zT);
+            }
+        }
+
+        return nPrimes;
+    }
+
+
+    /* Get the lane width for numbers of up to a number of bits. */
+    static uint32_t fermat_width(uint32_t nBits)
+    {
+        return std::min(((nBits + 4 + 51) / 52 + 3) / 4, (uint32_t)FERMAT_IFMA_WIDTHS) - 1;
+    }
+
+
+    /* Test up to 8 numbers in the lanes of a width. */
+    static uint32_t fermat_lanes(const mpz_srcptr *pN, uint32_t nCount, uint32_t nWidth, mpz_ptr *pR)
+    {
+        switch(nWidth)
+        {
+            case 0:  return fermat_ifma<4>(pN, nCount, pR);
+            case 1:  return fermat_ifma<8>(pN, nCount, pR);
+            case 2:  return fermat_ifma<12>(pN, nCount, pR);
+            case 3:  return fermat_ifma<16>(pN, nCount, pR);
+            case 4:  return fermat_ifma<20>(pN, nCount, pR);
+            default: return fermat_ifma<FERMAT_IFMA_LIMBS>(pN, nCount, pR);
+        }
+    }
+
+
+    /* Whether the lanes of each width measured faster than mpz_powm: zero
+       while they are being timed, then one if they did or minus one if not. */
+    static std::atomic<int32_t> vLanesFaster[FERMAT_IFMA_WIDTHS];
+
+    static uint64_t vLaneTime[FERMAT_IFMA_WIDTHS];
+    static uint64_t vPowmTime[FERMAT_IFMA_WIDTHS];
+    static uint32_t vCalibrated[FERMAT_IFMA_WIDTHS];
+    static bool vLaneMismatch[FERMAT_IFMA_WIDTHS];
+
+
+    /* Test a full vector in the lanes, and time it against mpz_powm on the same
+       numbers, until there are enough timings to tell which one is faster. Any
+       result that differs from mpz_powm keeps the lanes of the width off for good. */
+    static uint32_t fermat_calibrate(const mpz_srcptr *pN, uint32_t nWidth, mpz_ptr *pR)
+    {
+        runtime::timer timer;
+        uint32_t nPowmMask = 0;
+
+        timer.Start();
+        uint32_t nMask = fermat_lanes(pN, FERMAT_IFMA_LANES, nWidth, pR);
+        uint64_t nLanes = timer.ElapsedNanoseconds();
+
+        /* The residues of mpz_powm replace those of the lanes, as the reference. */
+        timer.Start();
+        for(uint32_t k = 0; k < FERMAT_IFMA_LANES; ++k)
+        {
+            if(fermat_powm(pN[k], pR ? pR[k] : nullptr))
+                nPowmMask |= 1 << k;
+        }
+        uint64_t nPowm = timer.ElapsedNanoseconds();
+
+        if(nMask != nPowmMask)
+            debug::error(FUNCTION, "lanes differ from mpz_powm");
+
+        std::unique_lock<std::mutex> lk(CALIBRATE_MUTEX);
+
+        vLaneTime[nWidth] += nLanes;
+        vPowmTime[nWidth] += nPowm;
+        vLaneMismatch[nWidth] |= (nMask != nPowmMask);
+
+        if(vLaneMismatch[nWidth])
+            vLanesFaster[nWidth] = -1;
+        else if(++vCalibrated[nWidth] == FERMAT_IFMA_CALIBRATE && vLanesFaster[nWidth].load() == 0)
+        {
+            bool fFaster = vLaneTime[nWidth] < vPowmTime[nWidth];
+
+            vLanesFaster[nWidth] = fFaster ? 1 : -1;
+
+            debug::log(2, FUNCTION, "lanes of ", std::min((nWidth + 1) * 4, (uint32_t)FERMAT_IFMA_LIMBS), " limbs run ", std::fixed, std::setprecision(2),
+                (double)vPowmTime[nWidth] / std::max(vLaneTime[nWidth], (uint64_t)1), "x mpz_powm, ",
+                fFaster ? "using them" : "using mpz_powm");
+        }
+
+        return nPowmMask;
+    }
+
+#endif
+
+
+    uint32_t FermatPrimes(const mpz_t *pN, uint32_t nCount, mpz_t *pR)
+    {
+        uint32_t nMask = 0;
+        uint32_t i;
+
+    #if defined(FERMAT_IFMA)
+        if(fIFMA)
+        {
+            mpz_srcptr vLanes[FERMAT_IFMA_LANES];
+            mpz_ptr vResidues[FERMAT_IFMA_LANES];
+            uint32_t vIndex[FERMAT_IFMA_LANES];
+            uint32_t nLanes = 0;
+            uint32_t nBits = 0;
+            uint32_t k;
+
+            for(i = 0; i < nCount; ++i)
+            {
+                uint32_t nSize = mpz_sizeinbase(pN[i], 2);
+
+                /* The lanes need an odd modulus below 2^(52 * FERMAT_IFMA_LIMBS - 4). */
+                if(!fermat_fits(pN[i]) || nSize + 4 > 52 * FERMAT_IFMA_LIMBS)
+                {
+                    if(fermat_test(pN[i], pR ? pR[i] : nullptr))
+                        nMask |= 1 << i;
+
+                    continue;
+                }
+
+                vLanes[nLanes] = pN[i];
+                vResidues[nLanes] = pR ? pR[i] : nullptr;
+                vIndex[nLanes] = i;
+                nBits = std::max(nBits, nSize);
+                ++nLanes;
+
+                /* Test a full vector, or what's left at the end if it's worth it. */
+                if(nLanes == FERMAT_IFMA_LANES || (i + 1 == nCount && nLanes >= FERMAT_IFMA_MIN))
+                {
+                    uint32_t nWidth = fermat_width(nBits);
+                    int32_t nFaster = vLanesFaster[nWidth].load();
+                    uint32_t nLaneMask = 0;
+
+                    /* Lanes that measured slower than mpz_powm leave the numbers to it. */
+                    if(nFaster < 0)
+                    {
+                        for(k = 0; k < nLanes; ++k)
+                        {
+                            if(fermat_test(vLanes[k], vResidues[k]))
+                                nLaneMask |= 1 << k;
+                        }
+                    }
+                    else if(nFaster == 0 && nLanes == FERMAT_IFMA_LANES)
+                        nLaneMask = fermat_calibrate(vLanes, nWidth, pR ? vResidues : nullptr);
+                    else
+                        nLaneMask = fermat_lanes(vLanes, nLanes, nWidth, pR ? vResidues : nullptr);
+
+                    for(k = 0; k < nLanes; ++k)
+                    {
+                        if(nLaneMask & (1 << k))
+                            nMask |= 1 << vIndex[k];
+                    }
+
+                    nLanes = 0;
+                    nBits = 0;
+                }
+            }
+
+            /* Too few left over to fill a vector. */
+            for(k = 0; k < nLanes; ++k)
+            {
+                if(fermat_test(vLanes[k], vResidues[k]))
+                    nMask |= 1 << vIndex[k];
+            }
+
+            return nMask;
+        }
+    #endif
+
+        for(i = 0; i < nCount; ++i)
+        {
+            if(fermat_test(pN[i], pR ? pR[i] : nullptr))
+                nMask |= 1 << i;
+        }
+
+        return nMask;
+    }
+
+
+    uint32_t FermatLanes()
+    {
+    #if defined(FERMAT_IFMA)
+        if(fIFMA)
+            return FERMAT_IFMA_LANES;
+    #endif
+
+        return 1;
+    }
+
+
+    void FermatBenchmark(uint32_t nBits, uint32_t nTests)
+    {
+        std::vector<uint32_t> vPrimes;
+        runtime::timer timer;
+        gmp_randstate_t state;
+        mpz_t zN[FERMAT_BATCH_MAX];
+        mpz_t zE;
+        mpz_t zR;
+        uint32_t nMismatch = 0;
+        uint32_t nFound = 0;
+        uint32_t i, k;
+
+        nTests = std::max(nTests, (uint32_t)FERMAT_BATCH_MAX);
+        nTests -= nTests % FERMAT_BATCH_MAX;
+        vPrimes.assign(nTests / FERMAT_BATCH_MAX, 0);
+
+        gmp_randinit_default(state);
+        mpz_init(zE);
+        mpz_init(zR);
+        for(k = 0; k < FERMAT_BATCH_MAX; ++k)
+            mpz_init(zN[k]);
+
+        debug::log(0, FUNCTION, "Testing ", nTests, " numbers of ", nBits, " bits, ", FermatLanes(), " lanes");
+
+        /* Reseed for each run so they all test the same numbers. */
+        auto next = [&](mpz_t zNext)
+        {
+            mpz_urandomb(zNext, state, nBits);
+            mpz_setbit(zNext, nBits - 1);
+            mpz_setbit(zNext, 0);
+        };
+
+        /* GMP reference. */
+        gmp_randseed_ui(state, nBits);
+        timer.Start();
+        for(i = 0; i < nTests; ++i)
+        {
+            next(zN[0]);
+            mpz_sub_ui(zE, zN[0], 1);
+            mpz_set_ui(zR, 2);
+            mpz_powm(zR, zR, zE, zN[0]);
+
+            if(mpz_cmp_ui(zR, 1) == 0)
+            {
+                vPrimes[i / FERMAT_BATCH_MAX] |= 1 << (i % FERMAT_BATCH_MAX);
+                ++nFound;
+            }
+        }
+        uint64_t nGMP = std::max(timer.ElapsedMicroseconds(), uint64_t(1));
+
+        /* One at a time, with the fixed width engine where it measures faster. */
+        gmp_randseed_ui(state, nBits);
+        timer.Start();
+        for(i = 0; i < nTests; ++i)
+        {
+            next(zN[0]);
+
+            bool fPrime = FermatPrime(zN[0]);
+            if(fPrime != (((vPrimes[i / FERMAT_BATCH_MAX] >> (i % FERMAT_BATCH_MAX)) & 1) == 1))
+                ++nMismatch;
+        }
+        uint64_t nSingle = std::max(timer.ElapsedMicroseconds(), uint64_t(1));
+
+        /* In batches. */
+        gmp_randseed_ui(state, nBits);
+        timer.Start();
+        for(i = 0; i < nTests; i += FERMAT_BATCH_MAX)
+        {
+            for(k = 0; k < FERMAT_BATCH_MAX; ++k)
+                next(zN[k]);
+
+            uint32_t nPrimes = FermatPrimes(zN, FERMAT_BATCH_MAX);
+            nMismatch += convert::popc(nPrimes ^ vPrimes[i / FERMAT_BATCH_MAX]);
+        }
+        uint64_t nBatch = std::max(timer.ElapsedMicroseconds(), uint64_t(1));
+
+        debug::log(0, FUNCTION, "mpz_powm     ", std::fixed, std::setprecision(2), (double)nGMP / nTests, " us/test");
+        debug::log(0, FUNCTION, "FermatPrime  ", std::fixed, std::setprecision(2), (double)nSingle / nTests, " us/test (",
+            (double)nGMP / nSingle, "x)");
+        debug::log(0, FUNCTION, "FermatPrimes ", std::fixed, std::setprecision(2), (double)nBatch / nTests, " us/test (",
+            (double)nGMP / nBatch, "x)");
+
+        if(nMismatch)
+            debug::error(FUNCTION, nMismatch, " results differ from mpz_powm");
+        else
+            debug::log(0, FUNCTION, "All results match mpz_powm, ", nFound, " probable primes");
+
+        for(k = 0; k < FERMAT_BATCH_MAX; ++k)
+            mpz_clear(zN[k]);
+        mpz_clear(zE);
+        mpz_clear(zR);
+        gmp_randclear(state);
+    }
+
+}
@@ -43,14 +43,16 @@ namespace LLC
     std::atomic<uint32_t> nChainCounts[14];
 
 
-    std::mutex g_work_mutex;
-    std::deque<work_info> g_work_queue;
+    work_queue g_work_queue;
+    verify_queue g_verify_queue;
+    test_context_cache g_test_contexts;
 
     std::atomic<uint32_t> nLargest;
     std::atomic<uint32_t> nBestHeight;
 
     std::atomic<uint64_t> SievedBits;
     std::atomic<uint64_t> Tests_CPU;
+    std::atomic<uint64_t> Candidates_CPU;
     std::atomic<uint64_t> Tests_GPU;
     std::atomic<uint64_t> PrimesFound[OFFSETS_MAX];
     std::atomic<uint64_t> PrimesChecked[OFFSETS_MAX];
@@ -0,0 +1,141 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_INCLUDE_CHAIN_INFO_H
+#define NEXUS_LLC_INCLUDE_CHAIN_INFO_H
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+#include <cstdint>
+
+/* The largest gap between two primes of a chain. */
+#define CHAIN_GAP_MAX 12
+
+namespace LLC
+{
+    /** chain_info
+     *
+     *  The evaluation of a prime chain of a candidate, built up as its numbers are
+     *  Fermat tested. Offsets are from the base of the candidate. The chain ends at
+     *  the first number past the gap after its last prime, and the Fermat residue
+     *  of that composite, kept from the test loops, gives the fractional difficulty
+     *  the same way GetPrimeDifficulty does.
+     *
+     **/
+    class chain_info
+    {
+    public:
+        chain_info();
+        ~chain_info();
+
+        chain_info(const chain_info &) = delete;
+        chain_info &operator=(const chain_info &) = delete;
+
+
+        /** reset
+         *
+         *  Start a new chain at a prime.
+         *
+         *  @param[in] nOffset The offset of the first prime.
+         *
+         **/
+        void reset(uint32_t nOffset);
+
+
+        /** extend
+         *
+         *  Add the next prime to the chain, at most CHAIN_GAP_MAX after the last one.
+         *
+         *  @param[in] nOffset The offset of the prime.
+         *
+         **/
+        void extend(uint32_t nOffset);
+
+
+        /** keep
+         *
+         *  Keep the Fermat residue of a tested composite, in case it ends the chain.
+         *
+         *  @param[in] nOffset The offset of the composite.
+         *  @param[in] zResidue The residue 2^(n - 1) mod n of the composite.
+         *
+         **/
+        void keep(uint32_t nOffset, const mpz_t zResidue);
+
+
+        /** difficulty
+         *
+         *  Get the difficulty of the chain, its length plus the fraction from the
+         *  residue of the composite that ends it. If that composite wasn't Fermat
+         *  tested, its residue is computed here.
+         *
+         *  @param[in] zBase The base of the candidate the offsets are from.
+         *
+         *  @return The difficulty in units of 10^-7.
+         *
+         **/
+        uint32_t difficulty(const mpz_t zBase);
+
+
+        /** begin
+         *
+         *  Get the offset of the first prime.
+         *
+         **/
+        uint32_t begin() const { return nBegin; }
+
+
+        /** last
+         *
+         *  Get the offset of the last prime.
+         *
+         **/
+        uint32_t last() const { return nLast; }
+
+
+        /** end
+         *
+         *  Get the offset of the composite that ends the chain.
+         *
+         **/
+        uint32_t end() const { return nLast + CHAIN_GAP_MAX + 2; }
+
+
+        /** length
+         *
+         *  Get the number of primes in the chain.
+         *
+         **/
+        uint32_t length() const { return nLength; }
+
+
+    private:
+        mpz_t zEnd;
+        mpz_t zResidue;
+
+        uint32_t nBegin;
+        uint32_t nLast;
+        uint32_t nLength;
+
+        /* The offset of the composite the kept residue belongs to. */
+        uint32_t nResidue;
+    };
+
+}
+
+#endif
@@ -15,7 +15,9 @@ ________________________________________________________________________________
 #ifndef NEXUS_LLC_INCLUDE_GLOBAL_H
 #define NEXUS_LLC_INCLUDE_GLOBAL_H
 
-#include <LLC/include/work_info.h>
+#include <LLC/include/work_queue.h>
+#include <LLC/include/verify_queue.h>
+#include <LLC/include/test_context.h>
 #include <CUDA/include/util.h>
 #include <CUDA/include/macro.h>
 
@@ -45,14 +47,16 @@ namespace LLC
     extern uint16_t primeLimitA;
     extern uint32_t primeLimitB;
 
-    extern std::mutex g_work_mutex;
-    extern std::deque<work_info> g_work_queue;
+    extern work_queue g_work_queue;
+    extern verify_queue g_verify_queue;
+    extern test_context_cache g_test_contexts;
 
     extern std::atomic<uint32_t> nLargest;
     extern std::atomic<uint32_t> nBestHeight;
 
     extern std::atomic<uint64_t> SievedBits;
     extern std::atomic<uint64_t> Tests_CPU;
+    extern std::atomic<uint64_t> Candidates_CPU;
     extern std::atomic<uint64_t> Tests_GPU;
     extern std::atomic<uint64_t> PrimesFound[OFFSETS_MAX];
     extern std::atomic<uint64_t> PrimesChecked[OFFSETS_MAX];
@@ -0,0 +1,79 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_INCLUDE_SIEVE_INFO_H
+#define NEXUS_LLC_INCLUDE_SIEVE_INFO_H
+
+#include <TAO/Ledger/types/block.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+namespace LLC
+{
+    /** sieve_info
+     *
+     *  The per-block state of the CPU sieve. It is built once per block and is
+     *  read only afterwards, except for the cursor that hands out the origins.
+     *
+     **/
+    class sieve_info
+    {
+    public:
+        sieve_info(const TAO::Ledger::Block &block_, uint32_t nPrimes, uint32_t nOrigins_, uint32_t nSievesPerOrigin_)
+        : block(block_)
+        , vBaseRemainders(nPrimes, 0)
+        , nOrigins(nOrigins_)
+        , nSievesPerOrigin(nSievesPerOrigin_)
+        , nCursor(0)
+        , nEpoch(0)
+        {
+            mpz_init(zBaseOrigin);
+        }
+
+        ~sieve_info()
+        {
+            mpz_clear(zBaseOrigin);
+        }
+
+        sieve_info(const sieve_info &) = delete;
+        sieve_info &operator=(const sieve_info &) = delete;
+
+        /* The block being sieved and its origin rounded up to the primorial. */
+        TAO::Ledger::Block block;
+        mpz_t zBaseOrigin;
+
+        /* The base origin mod each sieving prime. */
+        std::vector<uint32_t> vBaseRemainders;
+
+        /* The number of origins in the block, the number of consecutive sieves
+           of each, and the next origin to claim. */
+        uint32_t nOrigins;
+        uint32_t nSievesPerOrigin;
+        std::atomic<uint32_t> nCursor;
+
+        /* The work queue epoch the block was received in. */
+        uint32_t nEpoch;
+    };
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_INCLUDE_TEST_CONTEXT_H
+#define NEXUS_LLC_INCLUDE_TEST_CONTEXT_H
+
+#include <TAO/Ledger/types/block.h>
+#include <LLC/types/uint1024.h>
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* The number of block contexts kept, enough for every sieve with a block of its own. */
+#define TEST_CONTEXT_CACHE_SIZE 16
+
+/* The number of small primes that numbers the sieve did not cover are trial divided by. */
+#define TEST_TRIAL_PRIMES 2048
+
+namespace LLC
+{
+    /** test_context
+     *
+     *  The values every candidate of a block is tested from, computed once per
+     *  block: the proof hash, which is the prime origin, and the base origin
+     *  rounded up to the next multiple of the primorial. The residues of the base
+     *  origin modulo small primes let numbers the sieve didn't cover be trial
+     *  divided in 32 bits. Read only once built, so the test workers share it.
+     *
+     **/
+    class test_context
+    {
+    public:
+        test_context(const TAO::Ledger::Block &block);
+        ~test_context();
+
+        test_context(const test_context &) = delete;
+        test_context &operator=(const test_context &) = delete;
+
+
+        /** matches
+         *
+         *  Check if a block is the one this context was built for. The key is the
+         *  part of the header the proof hash covers, so no hash is computed.
+         *
+         *  @param[in] block The block to check.
+         *
+         **/
+        bool matches(const TAO::Ledger::Block &block) const;
+
+
+        /* The key, the header fields of the proof hash. */
+        uint1024_t hashPrevBlock;
+        uint512_t hashMerkleRoot;
+        uint32_t nVersion;
+        uint32_t nChannel;
+        uint32_t nHeight;
+        uint32_t nBits;
+
+        /* The proof hash, and the prime and base origins in GMP. */
+        uint1024_t hashProof;
+        mpz_t zPrimeOrigin;
+        mpz_t zBaseOrigin;
+
+        /* The trial division primes, from 3 up, with their inverses mod 2^32 and the
+           largest quotients, so a number divides if its product with the inverse is
+           no larger. Their reciprocals for 64-bit reductions, and the residues of the
+           base origin modulo each. */
+        std::vector<uint32_t> vTrialPrimes;
+        std::vector<uint32_t> vTrialInverse;
+        std::vector<uint32_t> vTrialLimit;
+        std::vector<uint64_t> vTrialRecip;
+        std::vector<uint32_t> vTrialBase;
+    };
+
+
+    /** test_context_cache
+     *
+     *  The contexts of the latest blocks, shared by all test workers. A context is
+     *  built by the first worker to get work of its block, and the oldest one is
+     *  dropped when the cache is full. Workers hold on to the context they use, so
+     *  it outlives the cache if it has to.
+     *
+     **/
+    class test_context_cache
+    {
+    public:
+        test_context_cache();
+
+
+        /** get
+         *
+         *  Get the context of a block, building it if it isn't cached.
+         *
+         *  @param[in] block The block to get the context of.
+         *
+         **/
+        std::shared_ptr<const test_context> get(const TAO::Ledger::Block &block);
+
+
+        /** clear
+         *
+         *  Drop all cached contexts.
+         *
+         **/
+        void clear();
+
+
+    private:
+        std::vector<std::shared_ptr<const test_context> > vContexts;
+        std::mutex MUTEX;
+    };
+
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_INCLUDE_VERIFY_QUEUE_H
+#define NEXUS_LLC_INCLUDE_VERIFY_QUEUE_H
+
+#include <TAO/Ledger/types/block.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace LLC
+{
+    /** verify_info
+     *
+     *  A chain the test workers found to reach the block difficulty.
+     *
+     **/
+    class verify_info
+    {
+    public:
+        verify_info() : nonce(0), difficulty(0), thr_id(0), epoch(0) {}
+        verify_info(const std::shared_ptr<const TAO::Ledger::Block> &block_,
+                    uint64_t nNonce,
+                    uint32_t nDifficulty,
+                    uint32_t tid,
+                    uint32_t nEpoch)
+        : block(block_)
+        , nonce(nNonce)
+        , difficulty(nDifficulty)
+        , thr_id(tid)
+        , epoch(nEpoch)
+        {
+        }
+
+        /* The block of the chain, and the nonce of its first prime. */
+        std::shared_ptr<const TAO::Ledger::Block> block;
+        uint64_t nonce;
+
+        /* The difficulty the test worker computed. */
+        uint32_t difficulty;
+
+        uint32_t thr_id;
+
+        /* The work queue epoch of the block. */
+        uint32_t epoch;
+    };
+
+
+    /** verify_queue
+     *
+     *  The queue of chains waiting for a full verification before they are
+     *  submitted. Chains only get here when they reach the block difficulty,
+     *  so a plain locked queue does.
+     *
+     **/
+    class verify_queue
+    {
+    public:
+        verify_queue();
+
+
+        /** push
+         *
+         *  Add a chain and wake up the verifier.
+         *
+         *  @param[in] info The chain to verify.
+         *
+         **/
+        void push(verify_info &&info);
+
+
+        /** pop
+         *
+         *  Wait for a chain to verify. The wait ends early when the given reset
+         *  flag is set and wake() is called.
+         *
+         *  @param[out] info The chain taken.
+         *  @param[in] fReset The reset flag of the verifier.
+         *
+         *  @return True if a chain was taken, false on reset.
+         *
+         **/
+        bool pop(verify_info &info, const std::atomic<bool> &fReset);
+
+
+        /** wake
+         *
+         *  Wake up the waiting verifier so it can check its reset flag.
+         *
+         **/
+        void wake();
+
+
+        /** clear
+         *
+         *  Remove all chains from the queue.
+         *
+         **/
+        void clear();
+
+
+    private:
+        std::deque<verify_info> qChains;
+
+        std::mutex MUTEX;
+        std::condition_variable CONDITION;
+    };
+
+}
+
+#endif
@@ -18,6 +18,7 @@ ________________________________________________________________________________
 #include <TAO/Ledger/types/block.h>
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace LLC
@@ -25,15 +26,19 @@ namespace LLC
     class work_info
     {
     public:
-        work_info() {}
+        work_info() : thr_id(0), tested_mask(0), epoch(0) {}
         work_info(const std::vector<uint64_t> &nOffsets,
                   const std::vector<uint32_t> &nMeta,
                   const TAO::Ledger::Block &block_,
-                  uint32_t tid)
+                  uint32_t tid,
+                  uint32_t nTested,
+                  uint32_t nEpoch)
         : nonce_offsets(nOffsets.begin(), nOffsets.end())
         , nonce_meta(nMeta.begin(), nMeta.end())
-        , block(block_)
+        , block(std::make_shared<const TAO::Ledger::Block>(block_))
         , thr_id(tid)
+        , tested_mask(nTested)
+        , epoch(nEpoch)
         {
         }
 
@@ -45,8 +50,16 @@ namespace LLC
         /* GPU intermediate results */
         std::vector<uint64_t> nonce_offsets;
         std::vector<uint32_t> nonce_meta;
-        TAO::Ledger::Block block;
+
+        /* The block of the nonces, shared by all chunks of the same results. */
+        std::shared_ptr<const TAO::Ledger::Block> block;
         uint32_t thr_id;
+
+        /* Offset indices already Fermat tested by the producer of the nonces. */
+        uint32_t tested_mask;
+
+        /* The work queue epoch the producer got its block in. */
+        uint32_t epoch;
     };
 
 }
@@ -0,0 +1,367 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_INCLUDE_WORK_QUEUE_H
+#define NEXUS_LLC_INCLUDE_WORK_QUEUE_H
+
+#include <LLC/include/work_info.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* The number of candidates in each chunk of work. */
+#define WORK_CHUNK_SIZE 64
+
+/* The number of chunks each priority ring can hold, the largest queue capacity. */
+#define WORK_RING_SIZE (1 << 14)
+
+/* The number of priority classes, each with a ring of its own. */
+#define WORK_PRIORITY_CLASSES 4
+
+/* The number of chunks a test worker can hold for others to steal. */
+#define WORK_DEQUE_SIZE 64
+
+/* The number of chunks a test worker takes from the global ring at once. */
+#define WORK_BATCH_SIZE 4
+
+/* The largest number of test workers with a deque of their own. */
+#define WORK_CONSUMERS_MAX 256
+
+/* The queue pressure, in percent of capacity, from which new work is shed and producers back off. */
+#define WORK_PRESSURE_SHED 50
+
+namespace LLC
+{
+    /** work_deque
+     *
+     *  A fixed size work stealing deque of chunks (Chase-Lev). The owning test
+     *  worker pushes and takes at the bottom, any other thread steals at the top.
+     *
+     **/
+    class work_deque
+    {
+    public:
+        work_deque();
+
+
+        /** push
+         *
+         *  Add a chunk to the bottom. Only called by the owner.
+         *
+         *  @param[in] pWork The chunk to add.
+         *
+         *  @return False if the deque is full.
+         *
+         **/
+        bool push(work_info *pWork);
+
+
+        /** take
+         *
+         *  Take the chunk at the bottom. Only called by the owner.
+         *
+         *  @return The chunk, or nullptr if the deque is empty.
+         *
+         **/
+        work_info *take();
+
+
+        /** steal
+         *
+         *  Steal the chunk at the top. Safe to call from any thread.
+         *
+         *  @return The chunk, or nullptr if the deque is empty or the steal lost a race.
+         *
+         **/
+        work_info *steal();
+
+
+    private:
+        std::atomic<int64_t> nTop;
+        std::atomic<int64_t> nBottom;
+        std::atomic<work_info *> vChunks[WORK_DEQUE_SIZE];
+    };
+
+
+    /** work_ring
+     *
+     *  A fixed size lock free ring of chunks (Vyukov bounded MPMC queue).
+     *
+     **/
+    class work_ring
+    {
+    public:
+        work_ring();
+
+
+        /** enqueue
+         *
+         *  Add a chunk to the ring.
+         *
+         *  @param[in] pWork The chunk to add.
+         *
+         *  @return False if the ring is full.
+         *
+         **/
+        bool enqueue(work_info *pWork);
+
+
+        /** dequeue
+         *
+         *  Take a chunk from the ring.
+         *
+         *  @return The chunk, or nullptr if the ring is empty.
+         *
+         **/
+        work_info *dequeue();
+
+
+    private:
+
+        struct cell
+        {
+            std::atomic<uint64_t> nSequence;
+            work_info *pWork;
+        };
+
+        std::unique_ptr<cell[]> vCells;
+        std::atomic<uint64_t> nEnqueue;
+        std::atomic<uint64_t> nDequeue;
+    };
+
+
+    /** work_queue
+     *
+     *  The queue of sieved candidates. Producers sort their candidates into priority
+     *  classes, split them into fixed size chunks, and add them to the lock free ring
+     *  of their class. Each test worker moves a few chunks at a time from the best
+     *  non-empty ring into its own deque, and steals from the others when all are
+     *  empty. Test workers only block on the condition when there is no work
+     *  anywhere, until a producer signals new work or they are woken up to reset.
+     *
+     *  Work is tagged with the epoch its block was received in. A new round bumps
+     *  the epoch and drops the queued chunks. Chunks of older epochs that are still
+     *  in flight are dropped as they are taken.
+     *
+     *  The queue holds up to a set capacity of chunks. Past WORK_PRESSURE_SHED
+     *  percent of it, producers are told to back off and only the most valuable
+     *  part of new work is kept.
+     *
+     **/
+    class work_queue
+    {
+    public:
+        work_queue();
+        ~work_queue();
+
+
+        /** push
+         *
+         *  Split the work into chunks, add them to the rings of their priority classes,
+         *  and wake up a waiting consumer. When the queue is past WORK_PRESSURE_SHED,
+         *  the lowest scoring candidates are shed, down to none of them at full capacity.
+         *  Chunks that find the ring of their class full are shed as a whole.
+         *
+         *  @param[in] work The work to add.
+         *
+         **/
+        void push(work_info &&work);
+
+
+        /** pop
+         *
+         *  Wait for a chunk of work. The wait ends early when the given reset flag
+         *  is set and wake() is called.
+         *
+         *  @param[in] nConsumer The index of the test worker, which owns a deque.
+         *  @param[out] work The chunk of work taken.
+         *  @param[out] nDepth The number of chunks left in the queue.
+         *  @param[in] fReset The reset flag of the waiting consumer.
+         *
+         *  @return True if work was taken, false on reset.
+         *
+         **/
+        bool pop(uint32_t nConsumer, work_info &work, uint32_t &nDepth, const std::atomic<bool> &fReset);
+
+
+        /** wake
+         *
+         *  Wake up all waiting consumers so they can check their reset flags.
+         *
+         **/
+        void wake();
+
+
+        /** clear
+         *
+         *  Remove all chunks from the ring and the deques.
+         *
+         **/
+        void clear();
+
+
+        /** size
+         *
+         *  Get the number of chunks waiting to be tested.
+         *
+         **/
+        uint32_t size() const { return nChunks.load(); }
+
+
+        /** set_capacity
+         *
+         *  Set the number of chunks the queue holds before it sheds all new work.
+         *
+         *  @param[in] nCapacity The capacity in chunks, at most WORK_RING_SIZE.
+         *
+         **/
+        void set_capacity(uint32_t nCapacity);
+
+
+        /** pressure
+         *
+         *  Get how full the queue is, as a percentage of its capacity. Producers
+         *  should start to back off from WORK_PRESSURE_SHED.
+         *
+         **/
+        uint32_t pressure() const { return static_cast<uint32_t>(uint64_t(nChunks.load()) * 100 / nCapacityChunks.load()); }
+
+
+        /** shed
+         *
+         *  Get the number of candidates shed since the last call, and reset it.
+         *
+         **/
+        uint64_t shed() { return nShed.exchange(0); }
+
+
+        /** score
+         *
+         *  Score a candidate by the longest run of its surviving sieved offsets
+         *  that doesn't break the prime gap rule, which bounds the chain it can start.
+         *
+         *  @param[in] nMeta The nonce meta, a set bit is an eliminated offset.
+         *  @param[in] nSieved The mask of the offsets the producers sieve.
+         *
+         *  @return The number of offsets in the run.
+         *
+         **/
+        static uint32_t score(uint32_t nMeta, uint32_t nSieved);
+
+
+        /** epoch
+         *
+         *  Get the current epoch, which producers tag their work with.
+         *
+         **/
+        uint32_t epoch() const { return nEpoch.load(); }
+
+
+        /** next_epoch
+         *
+         *  Start a new epoch, making all work queued or in flight obsolete. The queued
+         *  chunks are dropped right away, so they don't count against the capacity of
+         *  the new round. Call it before producers get the blocks of the new round.
+         *
+         **/
+        void next_epoch();
+
+
+        /** stale
+         *
+         *  Check if work belongs to an older epoch.
+         *
+         *  @param[in] work The work to check.
+         *
+         **/
+        bool stale(const work_info &work) const { return work.epoch != nEpoch.load(); }
+
+
+    private:
+
+        /** keep_best
+         *
+         *  Keep the highest scoring candidates, in their original order.
+         *
+         *  @param[in,out] work The work to shed candidates from.
+         *  @param[in] vScores The score of each candidate, kept in step.
+         *  @param[in] nKeep The number of candidates to keep.
+         *
+         **/
+        void keep_best(work_info &work, std::vector<uint32_t> &vScores, uint32_t nKeep);
+
+
+        /** push_chunks
+         *
+         *  Split work of a single priority class into chunks and add them to its ring.
+         *
+         *  @param[in] work The work to add.
+         *  @param[in] nClass The priority class of the work.
+         *
+         *  @return The number of chunks added.
+         *
+         **/
+        uint32_t push_chunks(work_info &&work, uint32_t nClass);
+
+
+        /** dequeue
+         *
+         *  Take a chunk from the best non-empty priority ring.
+         *
+         *  @param[out] nClass The class the chunk was taken from.
+         *
+         *  @return The chunk, or nullptr if all rings are empty.
+         *
+         **/
+        work_info *dequeue(uint32_t &nClass);
+
+
+        /** try_pop
+         *
+         *  Take a chunk from the own deque, then the rings, then the other deques.
+         *
+         *  @return The chunk, or nullptr if none was found.
+         *
+         **/
+        work_info *try_pop(uint32_t nConsumer);
+
+
+        std::unique_ptr<work_ring[]> vRings;
+        std::unique_ptr<work_deque[]> vDeques;
+        std::atomic<uint32_t> nConsumers;
+
+        /* Chunks not yet taken for testing, in the ring or in a deque. */
+        std::atomic<uint32_t> nChunks;
+
+        /* The consumers that are blocked, or about to block, on the condition. */
+        std::atomic<uint32_t> nSleepers;
+
+        /* The current epoch, bumped each new round. */
+        std::atomic<uint32_t> nEpoch;
+
+        /* The capacity in chunks, and the candidates shed for lack of room. */
+        std::atomic<uint32_t> nCapacityChunks;
+        std::atomic<uint64_t> nShed;
+
+        std::mutex MUTEX;
+        std::condition_variable CONDITION;
+    };
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 ____________________________________________________________________________________________*/
 
 #include <LLC/prime/origins.h>
+#include <LLC/prime/fermat.h>
 #include <LLC/include/global.h>
 #include <Util/include/debug.h>
 #include <Util/include/args.h>
@@ -45,8 +46,6 @@ namespace LLC
         mpz_t zFirstElement;
 
         mpz_t zTemp[MAX_THREADS];
-        mpz_t zResidue[MAX_THREADS];
-        mpz_t zN[MAX_THREADS];
         mpz_t zElement[MAX_THREADS];
         mpz_t zOrigin[MAX_THREADS];
 
@@ -82,8 +81,6 @@ namespace LLC
         for(int i = 0; i < nThreads; ++i)
         {
             mpz_init(zTemp[i]);
-            mpz_init(zResidue[i]);
-            mpz_init(zN[i]);
             mpz_init(zElement[i]);
             mpz_init(zOrigin[i]);
         }
@@ -176,10 +173,7 @@ namespace LLC
                         mpz_add_ui(zTemp[idx], zElement[idx], vOffsets[k]);
 
                         /* Check for Fermat test. */
-                        mpz_sub_ui(zN[idx], zTemp[idx], 1);
-                        mpz_powm(zResidue[idx], zTwo, zN[idx], zTemp[idx]);
-
-                        if (mpz_cmp_ui(zResidue[idx], 1) == 0)
+                        if(FermatPrime(zTemp[idx]))
                             nMask |= (1 << k);
                     }
                 }
@@ -247,8 +241,6 @@ namespace LLC
         for(int i = 0; i < nThreads; ++i)
         {
             mpz_clear(zTemp[i]);
-            mpz_clear(zResidue[i]);
-            mpz_clear(zN[i]);
             mpz_clear(zElement[i]);
             mpz_clear(zOrigin[i]);
         }
@@ -0,0 +1,70 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/prime/pattern.h>
+
+namespace LLC
+{
+
+    constexpr uint32_t offset_pattern<PATTERN_217153>::vPattern[];
+    constexpr uint32_t offset_pattern<PATTERN_217153>::vPatternA[];
+    constexpr uint32_t offset_pattern<PATTERN_217153>::vPatternB[];
+
+
+    /** matches
+     *
+     *  Check the loaded offsets and sieve indices against a specialized pattern.
+     *
+     **/
+    template<uint32_t nPattern>
+    static bool matches()
+    {
+        typedef offset_pattern<nPattern> pattern;
+        uint32_t i;
+
+        if(vOffsets.size() != pattern::size()
+        || vOffsetsA.size() != pattern::sizeA()
+        || vOffsetsB.size() != pattern::sizeB())
+            return false;
+
+        for(i = 0; i < pattern::size(); ++i)
+        {
+            if(vOffsets[i] != pattern::offset(i))
+                return false;
+        }
+
+        for(i = 0; i < pattern::sizeA(); ++i)
+        {
+            if(vOffsetsA[i] != pattern::indexA(i))
+                return false;
+        }
+
+        for(i = 0; i < pattern::sizeB(); ++i)
+        {
+            if(vOffsetsB[i] != pattern::indexB(i))
+                return false;
+        }
+
+        return true;
+    }
+
+
+    uint32_t find_pattern()
+    {
+        if(matches<PATTERN_217153>())
+            return PATTERN_217153;
+
+        return PATTERN_GENERIC;
+    }
+
+}
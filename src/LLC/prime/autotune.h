@@ -0,0 +1,37 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_AUTOTUNE_H
+#define NEXUS_LLC_PRIME_AUTOTUNE_H
+
+#include <cstdint>
+
+namespace LLC
+{
+
+    /** AutoTuneCPU
+     *
+     *  Sweep the CPU sieve size, sieving primes, and sieve/test thread split on
+     *  this host, measuring candidates/s and WPS on a test block, and write the
+     *  best settings back to the [CPU] section of config.ini.
+     *
+     *  @param[in] nThreads The total number of sieve and test threads.
+     *  @param[in] nSeconds The number of seconds to run each trial.
+     *
+     **/
+    void AutoTuneCPU(uint32_t nThreads, uint32_t nSeconds);
+
+}
+
+#endif
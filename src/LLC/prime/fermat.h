@@ -0,0 +1,103 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_FERMAT_H
+#define NEXUS_LLC_PRIME_FERMAT_H
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+#include <cstdint>
+
+/* The largest limb count of the fixed width engine and the batch lanes, a 1024-bit proof hash plus offsets. */
+#define FERMAT_LIMBS_MAX 17
+
+/* The largest number of candidates tested in one batch. */
+#define FERMAT_BATCH_MAX 32
+
+namespace LLC
+{
+
+    /** FermatPrime
+     *
+     *  Base 2 Fermat test, 2^(n - 1) mod n == 1. Numbers of up to
+     *  FERMAT_LIMBS_MAX limbs run on the fixed width Montgomery engine of
+     *  their limb count if it measured faster than mpz_powm. The first
+     *  numbers of each limb count are timed with both, and a result that
+     *  differs from mpz_powm keeps that limb count on mpz_powm.
+     *
+     *  @param[in] zN The number to test.
+     *
+     *  @return True if the number is a probable prime.
+     *
+     **/
+    bool FermatPrime(const mpz_t zN);
+
+
+    /** FermatResidue
+     *
+     *  Compute the base 2 Fermat residue, 2^(n - 1) mod n, with the engine
+     *  or mpz_powm as FermatPrime.
+     *
+     *  @param[out] zR The residue.
+     *  @param[in] zN The number to test.
+     *
+     **/
+    void FermatResidue(mpz_t zR, const mpz_t zN);
+
+
+    /** FermatPrimes
+     *
+     *  Base 2 Fermat test of a batch of independent numbers. On CPUs with
+     *  AVX-512 IFMA the numbers are tested 8 at a time, one in each 64-bit
+     *  lane, with 52-bit limbs. The first full vectors of each lane width are
+     *  timed against mpz_powm, and the lanes are only kept if they measure
+     *  faster. Otherwise, for a few numbers left over, or for numbers too
+     *  large for the lanes, they are tested one at a time with FermatPrime.
+     *
+     *  @param[in] pN The numbers to test.
+     *  @param[in] nCount The number of numbers, at most FERMAT_BATCH_MAX.
+     *  @param[out] pR If not null, the residue of each number, as FermatResidue.
+     *
+     *  @return A mask with bit i set if number i is a probable prime.
+     *
+     **/
+    uint32_t FermatPrimes(const mpz_t *pN, uint32_t nCount, mpz_t *pR = nullptr);
+
+
+    /** FermatLanes
+     *
+     *  Get the number of lanes the batch test runs in, 1 without SIMD support.
+     *
+     **/
+    uint32_t FermatLanes();
+
+
+    /** FermatBenchmark
+     *
+     *  Time mpz_powm against FermatPrime and FermatPrimes on random odd numbers,
+     *  check that they agree, and log the results.
+     *
+     *  @param[in] nBits The size of the numbers in bits.
+     *  @param[in] nTests The number of numbers to test with each.
+     *
+     **/
+    void FermatBenchmark(uint32_t nBits, uint32_t nTests);
+
+}
+
+#endif
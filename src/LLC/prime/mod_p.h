@@ -0,0 +1,86 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_MOD_P_H
+#define NEXUS_LLC_PRIME_MOD_P_H
+
+#include <cstdint>
+
+namespace LLC
+{
+
+    /** mod_p_small
+     *
+     *  Given a 64-bit operand and reciprocal, and 32-bit modulo, return the
+     *  32-bit modulus without using division (host side of the CUDA helper).
+     *
+     *  @param[in] a The 64-bit operand.
+     *  @param[in] p The 32-bit modulo.
+     *  @param[in] recip The reciprocal floor(2^64 / p) stored as invK.
+     *
+     *  @return a mod p
+     *
+     **/
+    inline uint32_t mod_p_small(uint64_t a, uint32_t p, uint64_t recip)
+    {
+        uint64_t q = (uint64_t)(((unsigned __int128)a * recip) >> 64);
+        uint64_t r = a - q * p;
+
+        if(r >= p)
+            r -= p;
+
+        return (uint32_t)r;
+    }
+
+
+    /** add_mod_p
+     *
+     *  Add a pattern offset to a remainder mod p. An offset can be larger than
+     *  the smallest sieving primes, so a sum of 2p or more is reduced in full.
+     *
+     *  @param[in] r The remainder, less than p.
+     *  @param[in] nOffset The offset to add.
+     *  @param[in] p The 32-bit modulo.
+     *
+     *  @return (r + nOffset) mod p
+     *
+     **/
+    constexpr uint32_t add_mod_p(uint32_t r, uint32_t nOffset, uint32_t p)
+    {
+        return r + nOffset < p ? r + nOffset
+            : r + nOffset - p < p ? r + nOffset - p
+            : (r + nOffset) % p;
+    }
+
+
+    /** get_recip
+     *
+     *  Get the reciprocal (invK) of the sieving prime at the given index.
+     *
+     *  @param[in] pPrimesInverseInvk The interleaved prime, inverse, invK table.
+     *  @param[in] i The index of the sieving prime.
+     *
+     *  @return The 64-bit reciprocal of the prime.
+     *
+     **/
+    inline uint64_t get_recip(const uint32_t *pPrimesInverseInvk, uint32_t i)
+    {
+        const uint32_t *pRecip = &pPrimesInverseInvk[i * 4 + 2];
+
+        return (uint64_t)pRecip[0] | ((uint64_t)pRecip[1] << 32);
+    }
+
+}
+
+#endif
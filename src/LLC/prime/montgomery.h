@@ -0,0 +1,273 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_MONTGOMERY_H
+#define NEXUS_LLC_PRIME_MONTGOMERY_H
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+#include <cstdint>
+
+namespace LLC
+{
+
+    /** montgomery
+     *
+     *  Modular arithmetic in Montgomery form for an odd modulus of a fixed number
+     *  of 64-bit limbs. All numbers are N limbs, least significant limb first, and
+     *  kept fully reduced. The limb count is known at compile time, so the loops
+     *  unroll and nothing is allocated, unlike the general sizes of mpz_powm.
+     *  Exponentiation is specialized to base 2, as used by all Fermat tests.
+     *
+     *  Products and reduction rows go through the mpn layer of GMP, which has
+     *  assembly kernels using mulx and adcx/adox where the CPU supports them.
+     *
+     **/
+    template<uint32_t N>
+    class montgomery
+    {
+    public:
+
+        /** montgomery
+         *
+         *  Set up the modulus, its inverse and R mod n for R = 2^(64 * N).
+         *
+         *  @param[in] pModulus The N limbs of the odd modulus, the top limb non-zero.
+         *
+         **/
+        explicit montgomery(const uint64_t *pModulus)
+        {
+            uint32_t i;
+
+            for(i = 0; i < N; ++i)
+                n[i] = pModulus[i];
+
+            /* Newton iteration for n^-1 mod 2^64, each step doubles the correct bits. */
+            uint64_t nInverse = n[0];
+            for(i = 0; i < 6; ++i)
+                nInverse *= 2 - n[0] * nInverse;
+
+            nPrime = 0 - nInverse;
+
+            /* Start from the top power of two below the modulus, and double it up to R. */
+            uint32_t nTopBits = 64 - __builtin_clzll(n[N - 1]);
+
+            for(i = 0; i < N; ++i)
+                one[i] = 0;
+
+            one[N - 1] = uint64_t(1) << (nTopBits - 1);
+
+            for(i = nTopBits - 1; i < 64; ++i)
+                dbl(one, one);
+        }
+
+
+        /** mul
+         *
+         *  Montgomery multiplication r = a * b / R mod n. The output may alias
+         *  either input.
+         *
+         **/
+        void mul(uint64_t *r, const uint64_t *a, const uint64_t *b) const
+        {
+            mp_limb_t t[2 * N];
+
+            if(a == b)
+                mpn_sqr(t, a, N);
+            else
+                mpn_mul_n(t, a, b, N);
+
+            redc(r, t);
+        }
+
+
+        /** dbl
+         *
+         *  Modular doubling r = 2a mod n. The output may alias the input.
+         *
+         **/
+        void dbl(uint64_t *r, const uint64_t *a) const
+        {
+            uint64_t nCarry = a[N - 1] >> 63;
+            uint32_t i;
+
+            for(i = N - 1; i > 0; --i)
+                r[i] = (a[i] << 1) | (a[i - 1] >> 63);
+            r[0] = a[0] << 1;
+
+            if(nCarry || !less(r, n))
+                sub(r, r, n);
+        }
+
+
+        /** pow2
+         *
+         *  Compute 2^e mod n in Montgomery form, left to right over the bits of the
+         *  exponent. The base is 2, so its multiplications are modular doublings
+         *  and only the squarings are Montgomery multiplications.
+         *
+         *  @param[out] x The result in Montgomery form.
+         *  @param[in] e The N limbs of the exponent.
+         *
+         **/
+        void pow2(uint64_t *x, const uint64_t *e) const
+        {
+            int32_t nBit = (int32_t)(N * 64) - 1;
+            while(nBit >= 0 && bit(e, nBit) == 0)
+                --nBit;
+
+            copy(x, one);
+            if(nBit < 0)
+                return;
+
+            /* The top bit is set, start from 2 in Montgomery form. */
+            dbl(x, x);
+
+            for(--nBit; nBit >= 0; --nBit)
+            {
+                mul(x, x, x);
+
+                if(bit(e, nBit))
+                    dbl(x, x);
+            }
+        }
+
+
+        /** fermat
+         *
+         *  Base 2 Fermat test of the modulus, 2^(n - 1) mod n == 1.
+         *
+         *  @return True if the modulus is a probable prime.
+         *
+         **/
+        bool fermat() const
+        {
+            uint64_t x[N];
+            uint64_t e[N];
+
+            /* The exponent n - 1, the modulus is odd so only the low bit changes. */
+            copy(e, n);
+            e[0] &= ~uint64_t(1);
+
+            pow2(x, e);
+
+            /* 1 in Montgomery form is R mod n. */
+            for(uint32_t i = 0; i < N; ++i)
+            {
+                if(x[i] != one[i])
+                    return false;
+            }
+
+            return true;
+        }
+
+
+        /** residue
+         *
+         *  Compute the base 2 Fermat residue of the modulus, 2^(n - 1) mod n.
+         *
+         *  @param[out] r The N limbs of the residue, fully reduced.
+         *
+         **/
+        void residue(uint64_t *r) const
+        {
+            mp_limb_t t[2 * N];
+            uint64_t e[N];
+            uint32_t i;
+
+            copy(e, n);
+            e[0] &= ~uint64_t(1);
+
+            pow2(t, e);
+
+            /* Out of Montgomery form, x / R mod n. */
+            for(i = N; i < 2 * N; ++i)
+                t[i] = 0;
+
+            redc(r, t);
+        }
+
+
+    private:
+
+        /** redc
+         *
+         *  Montgomery reduction r = t / R mod n of a double width product,
+         *  one limb at a time. The carry of each step is kept in the limb it
+         *  cleared, and added back in at the end.
+         *
+         **/
+        void redc(uint64_t *r, mp_limb_t *t) const
+        {
+            uint32_t i;
+
+            for(i = 0; i < N; ++i)
+                t[i] = mpn_addmul_1(t + i, n, N, t[i] * nPrime);
+
+            mp_limb_t nCarry = mpn_add_n(r, t + N, t, N);
+
+            /* The result is below 2n, reduce it once. */
+            if(nCarry || !less(r, n))
+                sub(r, r, n);
+        }
+
+
+        /* Get a bit of a number of N limbs. */
+        static uint64_t bit(const uint64_t *e, int32_t nBit)
+        {
+            return (e[nBit >> 6] >> (nBit & 63)) & 1;
+        }
+
+        static void copy(uint64_t *r, const uint64_t *a)
+        {
+            for(uint32_t i = 0; i < N; ++i)
+                r[i] = a[i];
+        }
+
+        static bool less(const uint64_t *a, const uint64_t *b)
+        {
+            for(uint32_t i = N; i-- > 0; )
+            {
+                if(a[i] != b[i])
+                    return a[i] < b[i];
+            }
+
+            return false;
+        }
+
+        static void sub(uint64_t *r, const uint64_t *a, const uint64_t *b)
+        {
+            uint64_t nBorrow = 0;
+
+            for(uint32_t i = 0; i < N; ++i)
+            {
+                unsigned __int128 d = (unsigned __int128)a[i] - b[i] - nBorrow;
+                r[i] = (uint64_t)d;
+                nBorrow = (uint64_t)(d >> 64) & 1;
+            }
+        }
+
+
+        uint64_t n[N];
+        uint64_t one[N];
+        uint64_t nPrime;
+    };
+
+}
+
+#endif
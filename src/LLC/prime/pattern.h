@@ -0,0 +1,100 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_PATTERN_H
+#define NEXUS_LLC_PRIME_PATTERN_H
+
+#include <Util/include/prime_config.h>
+
+#include <cstdint>
+
+/* The offset patterns with kernels specialized at compile time. Any other
+   pattern from offsets.ini runs the generic kernels. */
+#define PATTERN_GENERIC 0
+#define PATTERN_217153  1
+
+namespace LLC
+{
+
+    /** offset_pattern
+     *
+     *  The offsets and sieve indices of a pattern, for the kernels templated on
+     *  it. The generic pattern reads them from offsets.ini at runtime.
+     *
+     **/
+    template<uint32_t nPattern>
+    struct offset_pattern
+    {
+        static uint32_t size() { return vOffsets.size(); }
+        static uint32_t sizeA() { return vOffsetsA.size(); }
+        static uint32_t sizeB() { return vOffsetsB.size(); }
+
+        static uint32_t offset(uint32_t i) { return vOffsets[i]; }
+        static uint32_t indexA(uint32_t i) { return vOffsetsA[i]; }
+        static uint32_t indexB(uint32_t i) { return vOffsetsB[i]; }
+    };
+
+
+    /** offset_pattern<PATTERN_217153>
+     *
+     *  The pattern at 217153 + 510510n that offsets.ini ships with.
+     *
+     **/
+    template<>
+    struct offset_pattern<PATTERN_217153>
+    {
+        static constexpr uint32_t vPattern[19]  = { 0, 4, 6, 10, 16, 18, 24, 28, 30, 34, 40, 46, 48, 54, 58, 60, 66, 70, 76 };
+        static constexpr uint32_t vPatternA[6]  = { 0, 1, 2, 3, 4, 5 };
+        static constexpr uint32_t vPatternB[3]  = { 6, 7, 8 };
+
+        static constexpr uint32_t size() { return 19; }
+        static constexpr uint32_t sizeA() { return 6; }
+        static constexpr uint32_t sizeB() { return 3; }
+
+        static constexpr uint32_t offset(uint32_t i) { return vPattern[i]; }
+        static constexpr uint32_t indexA(uint32_t i) { return vPatternA[i]; }
+        static constexpr uint32_t indexB(uint32_t i) { return vPatternB[i]; }
+    };
+
+
+    /** sieve_array
+     *
+     *  Get the bit array a flattened sieving offset goes to. The A offsets share
+     *  the first bit array and each B offset has one of its own.
+     *
+     *  @param[in] o The index into the A and B sieving offsets.
+     *
+     *  @return The index of the bit array.
+     *
+     **/
+    template<uint32_t nPattern>
+    inline uint32_t sieve_array(uint32_t o)
+    {
+        return o < offset_pattern<nPattern>::sizeA() ? 0 : 1 + o - offset_pattern<nPattern>::sizeA();
+    }
+
+
+    /** find_pattern
+     *
+     *  Find the specialized pattern that matches the offsets and sieve indices
+     *  loaded from offsets.ini.
+     *
+     *  @return The pattern, or PATTERN_GENERIC if none matches.
+     *
+     **/
+    uint32_t find_pattern();
+
+}
+
+#endif
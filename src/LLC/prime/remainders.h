@@ -0,0 +1,45 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_PRIME_REMAINDERS_H
+#define NEXUS_LLC_PRIME_REMAINDERS_H
+
+#if defined(_MSC_VER)
+#include <mpir.h>
+#else
+#include <gmp.h>
+#endif
+
+#include <cstdint>
+
+namespace LLC
+{
+
+    /** ComputeRemainders
+     *
+     *  Compute the remainders of a multi-precision number for a range of the
+     *  sieving primes in one pass. Primes are reduced in pairs with a single
+     *  limb divisor, and split apart with their reciprocals from primesInverseInvk.
+     *
+     *  @param[in] zN The multi-precision number to reduce.
+     *  @param[in] nBegin The index of the first sieving prime.
+     *  @param[in] nEnd The index one past the last sieving prime.
+     *  @param[out] pRemainders The remainders, indexed by prime index.
+     *
+     **/
+    void ComputeRemainders(const mpz_t zN, uint32_t nBegin, uint32_t nEnd, uint32_t *pRemainders);
+
+}
+
+#endif
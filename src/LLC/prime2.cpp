@@ -11,6 +11,7 @@
 
 ____________________________________________________________________________________________*/
 #include <LLC/prime/prime2.h>
+#include <LLC/prime/fermat.h>
 
 #if defined(_MSC_VER)
 #include <mpir.h>
@@ -29,24 +30,20 @@ namespace LLC
     uint1024_t FermatTest(const uint1024_t &n)
     {
         uint1024_t r;
-        mpz_t zR, zE, zN, zA;
+        mpz_t zR, zN;
 
         mpz_init(zR);
-        mpz_init(zE);
         mpz_init(zN);
-        mpz_init_set_ui(zA, 2);
 
         mpz_import(zN, 32, -1, sizeof(uint32_t), 0, 0, n.begin());
 
-        mpz_sub_ui(zE, zN, 1);
-        mpz_powm(zR, zA, zE, zN);
+        /* The base is always 2. */
+        FermatResidue(zR, zN);
 
         mpz_export(r.begin(), 0, -1, sizeof(uint32_t), 0, 0, zR);
 
         mpz_clear(zR);
-        mpz_clear(zE);
         mpz_clear(zN);
-        mpz_clear(zA);
 
         return r;
     }
@@ -0,0 +1,63 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To The Voice of The People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/prime/remainders.h>
+#include <LLC/prime/mod_p.h>
+#include <LLC/include/global.h>
+
+#include <vector>
+#include <cstring> //memset
+
+namespace LLC
+{
+
+    void ComputeRemainders(const mpz_t zN, uint32_t nBegin, uint32_t nEnd, uint32_t *pRemainders)
+    {
+        const mp_limb_t *pLimbs = mpz_limbs_read(zN);
+        mp_size_t nLimbs = mpz_size(zN);
+
+        if(nBegin >= nEnd)
+            return;
+
+        /* A zero number has no limbs to reduce. */
+        if(nLimbs == 0)
+        {
+            memset(&pRemainders[nBegin], 0x00, (nEnd - nBegin) * sizeof(uint32_t));
+            return;
+        }
+
+        uint32_t i = nBegin;
+
+    #if GMP_LIMB_BITS >= 64
+        /* Two 32-bit primes multiply into a single limb divisor. Reduce the number by
+           the pair in one pass over its limbs, then split the 64-bit remainder with
+           each prime's reciprocal. That halves the multi-precision passes. */
+        for(; i + 2 <= nEnd; i += 2)
+        {
+            /* Get the global sieving primes. */
+            uint32_t p0 = primesInverseInvk[i * 4];
+            uint32_t p1 = primesInverseInvk[(i + 1) * 4];
+
+            uint64_t r = mpn_mod_1(pLimbs, nLimbs, (mp_limb_t)p0 * p1);
+
+            pRemainders[i]     = mod_p_small(r, p0, get_recip(primesInverseInvk, i));
+            pRemainders[i + 1] = mod_p_small(r, p1, get_recip(primesInverseInvk, i + 1));
+        }
+    #endif
+
+        /* Reduce the rest one prime at a time. */
+        for(; i < nEnd; ++i)
+            pRemainders[i] = mpn_mod_1(pLimbs, nLimbs, primesInverseInvk[i * 4]);
+    }
+
+}
@@ -0,0 +1,123 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/include/test_context.h>
+#include <LLC/include/global.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace LLC
+{
+
+    test_context::test_context(const TAO::Ledger::Block &block)
+    : hashPrevBlock(block.hashPrevBlock)
+    , hashMerkleRoot(block.hashMerkleRoot)
+    , nVersion(block.nVersion)
+    , nChannel(block.nChannel)
+    , nHeight(block.nHeight)
+    , nBits(block.nBits)
+    , hashProof(block.ProofHash())
+    {
+        mpz_init(zPrimeOrigin);
+        mpz_init(zBaseOrigin);
+
+        /* Get the prime origin from the block and import into GMP. */
+        mpz_import(zPrimeOrigin, 32, -1, sizeof(uint32_t), 0, 0, hashProof.begin());
+
+        /* Round the origin up to the next multiple of the primorial. */
+        mpz_mod(zBaseOrigin, zPrimeOrigin, zPrimorial);
+        mpz_sub(zBaseOrigin, zPrimorial, zBaseOrigin);
+        mpz_add(zBaseOrigin, zPrimeOrigin, zBaseOrigin);
+
+        /* The first prime is 2, which no odd candidate has. */
+        uint32_t nTrial = std::min((uint32_t)TEST_TRIAL_PRIMES, primes[0] - 1);
+
+        vTrialPrimes.resize(nTrial);
+        vTrialInverse.resize(nTrial);
+        vTrialLimit.resize(nTrial);
+        vTrialRecip.resize(nTrial);
+        vTrialBase.resize(nTrial);
+
+        for(uint32_t i = 0; i < nTrial; ++i)
+        {
+            uint32_t p = primes[i + 2];
+
+            /* Newton iteration for p^-1 mod 2^32. */
+            uint32_t nInverse = p;
+            for(uint32_t j = 0; j < 5; ++j)
+                nInverse *= 2 - p * nInverse;
+
+            vTrialPrimes[i] = p;
+            vTrialInverse[i] = nInverse;
+            vTrialLimit[i] = 0xFFFFFFFF / p;
+            vTrialRecip[i] = std::numeric_limits<uint64_t>::max() / p;
+            vTrialBase[i] = mpz_fdiv_ui(zBaseOrigin, p);
+        }
+    }
+
+
+    test_context::~test_context()
+    {
+        mpz_clear(zPrimeOrigin);
+        mpz_clear(zBaseOrigin);
+    }
+
+
+    bool test_context::matches(const TAO::Ledger::Block &block) const
+    {
+        return block.nHeight == nHeight
+            && block.hashMerkleRoot == hashMerkleRoot
+            && block.hashPrevBlock == hashPrevBlock
+            && block.nBits == nBits
+            && block.nVersion == nVersion
+            && block.nChannel == nChannel;
+    }
+
+
+    test_context_cache::test_context_cache()
+    : vContexts()
+    , MUTEX()
+    {
+    }
+
+
+    std::shared_ptr<const test_context> test_context_cache::get(const TAO::Ledger::Block &block)
+    {
+        std::unique_lock<std::mutex> lk(MUTEX);
+
+        for(const auto& context : vContexts)
+        {
+            if(context->matches(block))
+                return context;
+        }
+
+        /* Build the context under the lock, so the other workers wait for it instead of building their own. */
+        std::shared_ptr<const test_context> context = std::make_shared<const test_context>(block);
+
+        if(vContexts.size() >= TEST_CONTEXT_CACHE_SIZE)
+            vContexts.erase(vContexts.begin());
+
+        vContexts.push_back(context);
+
+        return context;
+    }
+
+
+    void test_context_cache::clear()
+    {
+        std::unique_lock<std::mutex> lk(MUTEX);
+        vContexts.clear();
+    }
+
+}
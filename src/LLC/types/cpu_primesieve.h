@@ -19,9 +19,14 @@ ________________________________________________________________________________
 #include <LLC/include/global.h>
 #include <LLC/prime/prime.h>
 #include <LLC/prime/prime2.h>
+#include <LLC/include/sieve_info.h>
 
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #if defined(_MSC_VER)
 #include <mpir.h>
@@ -93,37 +98,218 @@ namespace LLC
         virtual void Shutdown() override;
 
 
+        /** Reset
+         *
+         *  Reset the worker. The shared block owner also withdraws the shared
+         *  block, so the other sieve workers stop sieving it.
+         *
+         **/
+        virtual void Reset() override;
+
+
     private:
 
 
-        void cpu_sieve();
+        /** init_block
+         *
+         *  Build the per-block sieve state for the current block, and publish it
+         *  to the other sieve workers when the block is shared.
+         *
+         **/
+        void init_block();
 
 
-        void cpu_compact(uint64_t base_offset);
+        /** join_block
+         *
+         *  Pick up the shared block published by the shared block owner, waiting
+         *  until there is one with origins left to claim or the worker is reset.
+         *
+         *  @return True if there is a shared block to sieve, false on reset.
+         *
+         **/
+        bool join_block();
 
 
-        void sieve_offset(uint32_t i, uint32_t o);
+
+        /** cpu_sieve
+         *
+         *  Sieve the bit arrays of each interleaved origin.
+         *
+         *  @param[in] nLanes The number of interleaved origins to sieve.
+         *
+         **/
+        void cpu_sieve(uint32_t nLanes);
+
+
+        /** cpu_compact
+         *
+         *  Combine the A sieve with the B offset sieves into a combo for each
+         *  surviving candidate, and queue the ones that meet the combo threshold.
+         *  The nonce meta uses the GPU convention, a set bit is an eliminated offset.
+         *
+         *  @param[in] nLane The interleaved origin to compact.
+         *  @param[in] base_offset The nonce offset of the first bit array index.
+         *
+         **/
+        void cpu_compact(uint32_t nLane, uint64_t base_offset);
+
+
+        /** compact
+         *
+         *  The cpu_compact kernel, specialized for an offset pattern.
+         *
+         *  @param[in] nLane The interleaved origin to compact.
+         *  @param[in] base_offset The nonce offset of the first bit array index.
+         *
+         **/
+        template<uint32_t nPattern>
+        void compact(uint32_t nLane, uint64_t base_offset);
+
+
+        /** build_tiles
+         *
+         *  Build the repeating bit pattern of every tile prime for this sieve.
+         *  A tile is p words long, so it repeats word aligned every 32 * p bits,
+         *  and holds the hits of all sieving offsets of one bit array for that prime.
+         *
+         *  @param[in] nLane The interleaved origin to build the tiles for.
+         *
+         **/
+        void build_tiles(uint32_t nLane);
+
+
+        /** sieve_segment
+         *
+         *  Initialize one cache sized window of the bit array from the prime tiles,
+         *  then sieve the remaining small primes over it, advancing each prime's
+         *  next-hit cursor past the end of the window.
+         *
+         *  @param[in] nLane The interleaved origin to sieve.
+         *  @param[in] nBegin The first bit index of the window.
+         *  @param[in] nEnd The bit index one past the end of the window.
+         *
+         **/
+        void sieve_segment(uint32_t nLane, uint32_t nBegin, uint32_t nEnd);
+
+
+        /** sieve_primes
+         *
+         *  Sieve the small primes past the tiles over a window of the bit arrays,
+         *  from the cursors of each prime and offset, specialized for an offset pattern.
+         *
+         *  @param[in] pBitArray The bit arrays of the interleaved origin.
+         *  @param[in] nEnd The bit index one past the end of the window.
+         *
+         **/
+        template<uint32_t nPattern>
+        void sieve_primes(uint32_t *pBitArray, uint32_t nEnd);
+
+
+        /** sieve_index
+         *
+         *  Compute the first bit array index sieved by a prime for an offset.
+         *
+         *  @param[in] i The index of the sieving prime.
+         *  @param[in] o The index into the A and B sieving offsets.
+         *  @param[in] nLane The interleaved origin.
+         *
+         *  @return The starting bit array index.
+         *
+         **/
+        uint32_t sieve_index(uint32_t i, uint32_t o, uint32_t nLane);
+
+
+        /** bucket_sieve
+         *
+         *  Sieve the primes at least as large as a segment. Their hits are collected
+         *  into one bucket per segment and applied a segment at a time. The next hit
+         *  past the sieve is carried over to the sieve of the origin it falls in.
+         *
+         *  @param[in] nLanes The number of interleaved origins to sieve.
+         *
+         **/
+        void bucket_sieve(uint32_t nLanes);
+
+
+        /** bucket_init
+         *
+         *  File the first hit of each large prime and offset under the sieve of
+         *  the origin it falls in, on the first sieve of the claimed origins.
+         *  Each prime is applied to all interleaved origins before moving on to the next.
+         *
+         *  @param[in] nLanes The number of interleaved origins to sieve.
+         *
+         **/
+        void bucket_init(uint32_t nLanes);
+
+
+        /** bucket_flush
+         *
+         *  Apply and empty the bucket of hits for a segment of one sieve.
+         *
+         *  @param[in] nBucket The index of the bucket, sieve major.
+         *
+         **/
+        void bucket_flush(uint32_t nBucket);
 
         bool cpu_pretest(uint64_t nonce, uint32_t o);
 
 
     private:
 
-        std::vector<uint64_t> vWorkOrigins;
-        std::vector<uint64_t> vBaseRemainders;
+        std::shared_ptr<sieve_info> pInfo;
+        std::vector<uint32_t> vSieveRemainders;
+        std::vector<uint64_t> vLaneOrigins;
+        std::vector<uint32_t> vSieveOffsets;
+        std::vector<uint32_t> vSieveArrays;
+        std::vector<uint32_t> vSieveCursors;
+        std::vector<uint32_t> vTiles;
+        std::vector<uint64_t> vNonces;
+        std::vector<uint32_t> vMeta;
+        std::vector<uint32_t> vBuckets;
+        std::vector<uint32_t> vBucketCounts;
+
+        /* The next hits of the large primes, a list for each sieve of each claimed
+           origin, as pairs of the bit index and the prime index shifted over the bit array. */
+        std::vector<std::vector<uint32_t>> vPassHits;
+
+        /* The first claimed origin and the number of them, and the sieve of the
+           origins being sieved out of the number of sieves per origin. */
+        uint32_t nOriginBegin;
+        uint32_t nOriginLanes;
+        uint32_t nPass;
+        uint32_t nPasses;
         uint32_t nSieveBits;
+        uint32_t nSieveWords;
+        uint32_t nSieveArrays;
         uint32_t nSievePrimes;
+        uint32_t nPrimeLimitB;
+        uint32_t nComboThreshold;
+        uint32_t nBitmaskA;
+        uint32_t nSegmentBitsLog2;
+        uint32_t nSegmentBits;
+        uint32_t nPrimeLimitSegment;
+        uint32_t nTilePrimeMax;
+        uint32_t nPrimeLimitTile;
+        uint32_t nTileWords;
+        uint32_t nBucketSize;
         uint32_t *pBitArraySieve;
-        uint32_t nSieveIndex;
-        uint32_t nBitArrayIndex;
         uint32_t nSievesPerOriginCPU;
+        uint32_t nSievesPerOriginMax;
+        uint32_t nInterleave;
+        bool fPreTest;
+        bool fShared;
+        bool fOwner;
         mpz_t zPrimeOrigin;
-        mpz_t zBaseOrigin;
         mpz_t zPrimorialMod;
         mpz_t zTempVar;
-        mpz_t zFirstSieveElement;
-        mpz_t zN;
-        mpz_t zResidue;
+
+        /* The block shared by all sieve workers, published by worker 0, and the
+           number of workers sharing it. */
+        static std::mutex SHARED_MUTEX;
+        static std::condition_variable SHARED_CONDITION;
+        static std::shared_ptr<sieve_info> pSharedInfo;
+        static std::atomic<uint32_t> nSharedWorkers;
 
     };
 }
@@ -19,9 +19,13 @@ ________________________________________________________________________________
 #include <LLC/include/global.h>
 #include <LLC/prime/prime.h>
 #include <LLC/prime/prime2.h>
+#include <LLC/prime/fermat.h>
+#include <LLC/include/chain_info.h>
+#include <LLC/include/test_context.h>
 
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <vector>
 
 #if defined(_MSC_VER)
 #include <mpir.h>
@@ -29,6 +33,9 @@ ________________________________________________________________________________
 #include <gmp.h>
 #endif
 
+/* The chain bound of a candidate that can still grow past its last offset. */
+#define CHAIN_UNBOUNDED 0xFFFFFFFF
+
 /* Forward declared. */
 namespace TAO
 {
@@ -93,21 +100,193 @@ namespace LLC
         virtual void Shutdown() override;
 
 
+        /** Reset
+         *
+         *  Reset the worker, waking it up if it is waiting on the work queue.
+         *
+         **/
+        virtual void Reset() override;
+
+
+        /** chain_bound
+         *
+         *  Get the longest chain the surviving offsets of a candidate can still make,
+         *  from the longest run of survivors with no gap wider than CHAIN_GAP_MAX,
+         *  wherever it starts. A run that reaches the last offset can grow into the
+         *  gap after it, and is unbounded. The later arguments carry the walk.
+         *
+         *  @param[in] nSurvivors The mask of offsets not eliminated yet.
+         *  @param[in] n The index of the offset the walk is at.
+         *  @param[in] t The index of the last survivor of the open run.
+         *  @param[in] nRun The length of the open run.
+         *  @param[in] nBest The length of the longest run so far.
+         *
+         *  @return The number of primes in the chain, or CHAIN_UNBOUNDED.
+         *
+         **/
+        template<uint32_t nPattern>
+        static constexpr uint32_t chain_bound(uint32_t nSurvivors, uint32_t n = 0, uint32_t t = 0, uint32_t nRun = 0, uint32_t nBest = 0);
+
+
+    private:
+
+
+        /** test_work
+         *
+         *  Test the candidates of the chunk of work taken, with the kernels
+         *  specialized for an offset pattern.
+         *
+         *  @param[in] nDepth The number of chunks left in the queue.
+         *
+         *  @return False, as the chains found go to the verify queue.
+         *
+         **/
+        template<uint32_t nPattern>
+        bool test_work(uint32_t nDepth);
+
+
+        /** test_level
+         *
+         *  Fermat test the untested offsets in a level mask across all candidates
+         *  of the work at once, in dense batches, then compact the candidates that
+         *  are left. A candidate is dropped if an offset it requires isn't prime, or
+         *  if its chain bound falls below the minimum.
+         *
+         *  @param[in] nLevelMask The offset indices to test in this level.
+         *  @param[in] nRequired The offset indices that must be prime to keep a candidate.
+         *  @param[in] nChainMin The shortest chain bound to keep a candidate.
+         *
+         *  @return False if the work went stale or the worker was reset.
+         *
+         **/
+        template<uint32_t nPattern>
+        bool test_level(uint32_t nLevelMask, uint32_t nRequired, uint32_t nChainMin);
+
+
+        /** test_batch
+         *
+         *  Fermat test a gathered batch of numbers of a level, and take the
+         *  results into the survivors of their candidates.
+         *
+         *  @param[in] nBatch The number of numbers in the batch.
+         *
+         *  @return False if the work went stale or the worker was reset.
+         *
+         **/
+        bool test_batch(uint32_t nBatch);
+
+
+        /** test_gaps
+         *
+         *  Fermat test a gathered batch of gap numbers, and extend the chains of
+         *  their candidates with the primes, keeping the residues of the composites.
+         *
+         *  @param[in] nBatch The number of numbers in the batch.
+         *
+         *  @return False if the work went stale or the worker was reset.
+         *
+         **/
+        bool test_gaps(uint32_t nBatch);
+
+
+        /** chain_run
+         *
+         *  Build a chain from a run of survivors, with no gap wider than CHAIN_GAP_MAX.
+         *
+         *  @param[out] chain The chain to build.
+         *  @param[in] nRun The mask of the offsets of the run.
+         *
+         **/
+        template<uint32_t nPattern>
+        static void chain_run(chain_info &chain, uint32_t nRun);
+
+
+        /** trial_residues
+         *
+         *  Compute the residues of the base of a candidate modulo the trial division
+         *  primes from the residues of the base origin, with one reciprocal
+         *  reduction per prime, the same way the sieve computes its remainders.
+         *
+         *  @param[in] nTrial The slot of the residues of the candidate.
+         *  @param[in] offset The nonce offset of the candidate.
+         *
+         **/
+        void trial_residues(uint32_t nTrial, uint64_t offset);
+
+
+        /** trial_composite
+         *
+         *  Trial divide a number of a candidate by the small primes of the block
+         *  context, in 32-bit arithmetic, for the numbers the sieve didn't cover.
+         *
+         *  @param[in] nTrial The slot of the residues of the candidate.
+         *  @param[in] nOffset The offset of the number from the base of the candidate.
+         *
+         *  @return True if the number has a small factor.
+         *
+         **/
+        bool trial_composite(uint32_t nTrial, uint32_t nOffset);
+
+
     private:
 
         mpz_t zTempVar;
-        mpz_t zN;
         mpz_t zBaseOffsetted;
-        mpz_t zBaseOrigin;
-        mpz_t zPrimeOrigin;
-        mpz_t zResidue;
-        mpz_t zPrimorialMod;
+
+        /* The numbers Fermat tested together in one batch, and their residues. */
+        mpz_t zBatch[FERMAT_BATCH_MAX];
+        mpz_t zResidues[FERMAT_BATCH_MAX];
 
         work_info work;
 
-        std::map<uint32_t, uint32_t> mapTest;
+        /** test_candidate
+         *
+         *  A candidate of the work between its test levels.
+         *
+         **/
+        struct test_candidate
+        {
+            uint64_t offset;
+
+            /* The sieve meta of the nonce, zero for candidates without it. */
+            uint32_t combo;
+
+            /* The offset indices not eliminated yet, and those not Fermat tested yet. */
+            uint32_t nSurvivors;
+            uint32_t nUntested;
+
+            /* The slot of the trial division residues of the candidate. */
+            uint32_t nTrial;
+        };
+
+        /* The candidates of the work still being tested. */
+        test_candidate vCandidates[WORK_CHUNK_SIZE];
+        uint32_t nCandidates;
+
+        /* The candidates of the numbers in a test batch, and their offset indices,
+           or their offsets for the numbers of a gap search. */
+        uint8_t vBatchCandidates[FERMAT_BATCH_MAX];
+        uint32_t vBatchOffsets[FERMAT_BATCH_MAX];
+
+        /* The proof hash and origins of the block of the work. */
+        std::shared_ptr<const test_context> context;
+
+        /* The chains of the candidates, built up from their survivors and gaps. */
+        chain_info vChains[WORK_CHUNK_SIZE];
+
+        /* The residues of the base of each candidate of the work modulo the trial
+           division primes, set up once per work item. */
+        std::vector<uint32_t> vTrial;
+
+        /* The offset indices the sieves cover. */
+        uint32_t nSievedMask;
+
         uint32_t gpu_begin;
         uint32_t gpu_end;
+        uint32_t nPreTestMin;
+        uint32_t nPreTestMax;
+        uint32_t nMinChain;
+        uint32_t nTestLevels;
 
     };
 }
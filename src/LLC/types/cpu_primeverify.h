@@ -0,0 +1,96 @@
+/*__________________________________________________________________________________________
+
+            (c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+            (c) Copyright The Nexus Developers 2014 - 2019
+
+            Distributed under the MIT software license, see the accompanying
+            file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+            "ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#pragma once
+#ifndef NEXUS_LLC_TYPES_CPU_PRIMEVERIFY_H
+#define NEXUS_LLC_TYPES_CPU_PRIMEVERIFY_H
+
+#include <LLC/types/proof.h>
+#include <LLC/include/verify_queue.h>
+
+#include <cstdint>
+
+
+namespace LLC
+{
+    /** PrimeVerifyCPU
+     *
+     *  Verifies the chains the test workers found to reach the block difficulty
+     *  with the OpenSSL prime checks, and submits the blocks that hold up.
+     *
+     **/
+    class PrimeVerifyCPU : public Proof
+    {
+    public:
+
+        PrimeVerifyCPU(uint32_t id);
+        virtual ~PrimeVerifyCPU();
+
+        /** Channel
+         *
+         *
+         *
+         **/
+        virtual uint32_t Channel() override { return 1; }
+
+
+        /** Work
+         *
+         *  Wait for a chain and verify it.
+         *
+         *  @return True if the block is ready to submit.
+         *
+         **/
+        virtual bool Work() override;
+
+
+        /** Load
+         *
+         *
+         *
+         **/
+        virtual void Load() override;
+
+
+        /** Init
+         *
+         *
+         *
+         **/
+        virtual void Init() override;
+
+
+        /** Shutdown
+         *
+         *
+         *
+         **/
+        virtual void Shutdown() override;
+
+
+        /** Reset
+         *
+         *  Reset the worker, waking it up if it is waiting on the verify queue.
+         *
+         **/
+        virtual void Reset() override;
+
+
+    private:
+
+        verify_info info;
+
+    };
+}
+
+#endif
@@ -125,6 +125,7 @@ namespace LLC
         uint32_t nPrimeLimitA;
         uint32_t nPrimeLimitB;
         uint8_t nTestLevel;
+        uint32_t nEpoch;
 
 
     };
@@ -0,0 +1,69 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/include/verify_queue.h>
+
+namespace LLC
+{
+
+    verify_queue::verify_queue()
+    : qChains()
+    , MUTEX()
+    , CONDITION()
+    {
+    }
+
+
+    void verify_queue::push(verify_info &&info)
+    {
+        {
+            std::unique_lock<std::mutex> lk(MUTEX);
+            qChains.push_back(std::move(info));
+        }
+
+        CONDITION.notify_one();
+    }
+
+
+    bool verify_queue::pop(verify_info &info, const std::atomic<bool> &fReset)
+    {
+        std::unique_lock<std::mutex> lk(MUTEX);
+        CONDITION.wait(lk, [this, &fReset] { return !qChains.empty() || fReset.load(); });
+
+        if(fReset.load())
+            return false;
+
+        info = std::move(qChains.front());
+        qChains.pop_front();
+
+        return true;
+    }
+
+
+    void verify_queue::wake()
+    {
+        {
+            std::unique_lock<std::mutex> lk(MUTEX);
+        }
+
+        CONDITION.notify_all();
+    }
+
+
+    void verify_queue::clear()
+    {
+        std::unique_lock<std::mutex> lk(MUTEX);
+        qChains.clear();
+    }
+
+}
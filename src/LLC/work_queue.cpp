@@ -0,0 +1,526 @@
+/*__________________________________________________________________________________________
+
+			(c) Hash(BEGIN(Satoshi[2010]), END(Sunny[2012])) == Videlicet[2014] ++
+
+			(c) Copyright The Nexus Developers 2014 - 2019
+
+			Distributed under the MIT software license, see the accompanying
+			file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+			"ad vocem populi" - To the Voice of the People
+
+____________________________________________________________________________________________*/
+
+#include <LLC/include/work_queue.h>
+#include <LLC/include/chain_info.h>
+
+#include <Util/include/bitmanip.h>
+#include <Util/include/prime_config.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace LLC
+{
+    work_deque::work_deque()
+    : nTop(0)
+    , nBottom(0)
+    {
+        for(uint32_t i = 0; i < WORK_DEQUE_SIZE; ++i)
+            vChunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+
+    bool work_deque::push(work_info *pWork)
+    {
+        int64_t b = nBottom.load(std::memory_order_relaxed);
+        int64_t t = nTop.load(std::memory_order_acquire);
+
+        if(b - t >= WORK_DEQUE_SIZE)
+            return false;
+
+        vChunks[b & (WORK_DEQUE_SIZE - 1)].store(pWork, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        nBottom.store(b + 1, std::memory_order_relaxed);
+
+        return true;
+    }
+
+
+    work_info *work_deque::take()
+    {
+        /* Claim the bottom chunk before looking at the top. */
+        int64_t b = nBottom.load(std::memory_order_relaxed) - 1;
+        nBottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = nTop.load(std::memory_order_relaxed);
+
+        if(t > b)
+        {
+            /* The deque was empty. */
+            nBottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        work_info *pWork = vChunks[b & (WORK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+        /* The last chunk goes to whoever moves the top first, the owner or a thief. */
+        if(t == b)
+        {
+            if(!nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                pWork = nullptr;
+
+            nBottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return pWork;
+    }
+
+
+    work_info *work_deque::steal()
+    {
+        int64_t t = nTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = nBottom.load(std::memory_order_acquire);
+
+        if(t >= b)
+            return nullptr;
+
+        work_info *pWork = vChunks[t & (WORK_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+
+        /* Lost the race against the owner or another thief. */
+        if(!nTop.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return pWork;
+    }
+
+
+    work_ring::work_ring()
+    : vCells(new cell[WORK_RING_SIZE])
+    , nEnqueue(0)
+    , nDequeue(0)
+    {
+        for(uint32_t i = 0; i < WORK_RING_SIZE; ++i)
+        {
+            vCells[i].nSequence.store(i, std::memory_order_relaxed);
+            vCells[i].pWork = nullptr;
+        }
+    }
+
+
+    bool work_ring::enqueue(work_info *pWork)
+    {
+        uint64_t nPos = nEnqueue.load(std::memory_order_relaxed);
+        cell *pCell = nullptr;
+
+        for(;;)
+        {
+            pCell = &vCells[nPos & (WORK_RING_SIZE - 1)];
+            uint64_t nSequence = pCell->nSequence.load(std::memory_order_acquire);
+            int64_t nDiff = (int64_t)nSequence - (int64_t)nPos;
+
+            if(nDiff == 0)
+            {
+                if(nEnqueue.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(nDiff < 0)
+                return false;
+            else
+                nPos = nEnqueue.load(std::memory_order_relaxed);
+        }
+
+        pCell->pWork = pWork;
+        pCell->nSequence.store(nPos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+
+    work_info *work_ring::dequeue()
+    {
+        uint64_t nPos = nDequeue.load(std::memory_order_relaxed);
+        cell *pCell = nullptr;
+
+        for(;;)
+        {
+            pCell = &vCells[nPos & (WORK_RING_SIZE - 1)];
+            uint64_t nSequence = pCell->nSequence.load(std::memory_order_acquire);
+            int64_t nDiff = (int64_t)nSequence - (int64_t)(nPos + 1);
+
+            if(nDiff == 0)
+            {
+                if(nDequeue.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(nDiff < 0)
+                return nullptr;
+            else
+                nPos = nDequeue.load(std::memory_order_relaxed);
+        }
+
+        work_info *pWork = pCell->pWork;
+        pCell->nSequence.store(nPos + WORK_RING_SIZE, std::memory_order_release);
+
+        return pWork;
+    }
+
+
+    work_queue::work_queue()
+    : vRings(new work_ring[WORK_PRIORITY_CLASSES])
+    , vDeques(new work_deque[WORK_CONSUMERS_MAX])
+    , nConsumers(0)
+    , nChunks(0)
+    , nSleepers(0)
+    , nEpoch(0)
+    , nCapacityChunks(WORK_RING_SIZE)
+    , nShed(0)
+    , MUTEX()
+    , CONDITION()
+    {
+    }
+
+
+    work_queue::~work_queue()
+    {
+        clear();
+    }
+
+
+    void work_queue::push(work_info &&work)
+    {
+        uint32_t nCandidates = work.nonce_offsets.size();
+        uint32_t nNewChunks = 0;
+
+        /* Drop work for a block of an older round. */
+        if(stale(work) || nCandidates == 0)
+            return;
+
+        /* Get the offsets the producers sieve, which the scores are made of. */
+        uint32_t nSieved = 0;
+        for(uint32_t i = 0; i < vOffsetsA.size(); ++i)
+            nSieved |= 1 << vOffsetsA[i];
+        for(uint32_t i = 0; i < vOffsetsB.size(); ++i)
+            nSieved |= 1 << vOffsetsB[i];
+
+        std::vector<uint32_t> vScores(nCandidates);
+        for(uint32_t i = 0; i < nCandidates; ++i)
+            vScores[i] = score(work.nonce_meta[i], nSieved);
+
+        /* Past the shedding pressure, keep a shrinking share of the work, the best first. */
+        uint32_t nCapacity = nCapacityChunks.load();
+        uint32_t nQueued = std::min(nChunks.load(), nCapacity);
+        if((uint64_t)nQueued * 100 > (uint64_t)nCapacity * WORK_PRESSURE_SHED)
+        {
+            uint32_t nKeep = (uint64_t)nCandidates * 100 * (nCapacity - nQueued) / ((uint64_t)nCapacity * (100 - WORK_PRESSURE_SHED));
+
+            nShed += nCandidates - nKeep;
+            keep_best(work, vScores, nKeep);
+
+            nCandidates = nKeep;
+        }
+
+        /* The class is how many sieved offsets short of a full run a candidate is. */
+        uint32_t nTopScore = convert::popc(nSieved);
+        uint32_t nClassMask = 0;
+        std::vector<uint8_t> vClasses(nCandidates);
+        for(uint32_t i = 0; i < nCandidates; ++i)
+        {
+            vClasses[i] = std::min(nTopScore - std::min(vScores[i], nTopScore), (uint32_t)WORK_PRIORITY_CLASSES - 1);
+            nClassMask |= 1 << vClasses[i];
+        }
+
+        /* Move the work as it is when all of it falls in one class. */
+        if(convert::popc(nClassMask) == 1)
+            nNewChunks += push_chunks(std::move(work), convert::ctz(nClassMask));
+        else
+        {
+            for(uint32_t nClass = 0; nClass < WORK_PRIORITY_CLASSES; ++nClass)
+            {
+                if(!(nClassMask & (1 << nClass)))
+                    continue;
+
+                work_info classwork;
+                classwork.block = work.block;
+                classwork.thr_id = work.thr_id;
+                classwork.tested_mask = work.tested_mask;
+                classwork.epoch = work.epoch;
+
+                for(uint32_t i = 0; i < nCandidates; ++i)
+                {
+                    if(vClasses[i] != nClass)
+                        continue;
+
+                    classwork.nonce_offsets.push_back(work.nonce_offsets[i]);
+                    classwork.nonce_meta.push_back(work.nonce_meta[i]);
+                }
+
+                nNewChunks += push_chunks(std::move(classwork), nClass);
+            }
+        }
+
+        /* Wake up the consumers waiting on the condition. */
+        if(nNewChunks && nSleepers.load() > 0)
+        {
+            {
+                std::unique_lock<std::mutex> lk(MUTEX);
+            }
+
+            if(nNewChunks == 1)
+                CONDITION.notify_one();
+            else
+                CONDITION.notify_all();
+        }
+    }
+
+
+    uint32_t work_queue::push_chunks(work_info &&work, uint32_t nClass)
+    {
+        uint32_t nCandidates = work.nonce_offsets.size();
+        uint32_t nNewChunks = 0;
+
+        for(uint32_t nBegin = 0; nBegin < nCandidates; nBegin += WORK_CHUNK_SIZE)
+        {
+            work_info *pWork = nullptr;
+
+            /* Split the candidates into chunks, moving the work when it fits in one. */
+            if(nCandidates <= WORK_CHUNK_SIZE)
+                pWork = new work_info(std::move(work));
+            else
+            {
+                uint32_t nEnd = std::min(nBegin + WORK_CHUNK_SIZE, nCandidates);
+
+                pWork = new work_info();
+                pWork->nonce_offsets.assign(work.nonce_offsets.begin() + nBegin, work.nonce_offsets.begin() + nEnd);
+                pWork->nonce_meta.assign(work.nonce_meta.begin() + nBegin, work.nonce_meta.begin() + nEnd);
+                pWork->block = work.block;
+                pWork->thr_id = work.thr_id;
+                pWork->tested_mask = work.tested_mask;
+                pWork->epoch = work.epoch;
+            }
+
+            /* Count the chunk before it is visible, so the count never runs behind. */
+            ++nChunks;
+
+            /* Shed the chunk if the ring is full, rather than wait for room that may never come. */
+            if(!vRings[nClass].enqueue(pWork))
+            {
+                nShed += pWork->nonce_offsets.size();
+                delete pWork;
+                --nChunks;
+
+                continue;
+            }
+
+            ++nNewChunks;
+        }
+
+        return nNewChunks;
+    }
+
+
+    bool work_queue::pop(uint32_t nConsumer, work_info &work, uint32_t &nDepth, const std::atomic<bool> &fReset)
+    {
+        while(!fReset.load())
+        {
+            work_info *pWork = try_pop(nConsumer);
+
+            /* Drop chunks of an older round without testing them. */
+            if(pWork && stale(*pWork))
+            {
+                delete pWork;
+                continue;
+            }
+
+            if(pWork)
+            {
+                work = std::move(*pWork);
+                delete pWork;
+
+                nDepth = nChunks.load();
+                return true;
+            }
+
+            /* A chunk is on its way into the ring or a deque, so try again. */
+            if(nChunks.load() > 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            /* Block until a producer or a reset wakes us up. Announcing the sleeper
+               before checking the count pairs with the producer counting the chunk
+               before checking for sleepers, so one of the two always sees the other. */
+            std::unique_lock<std::mutex> lk(MUTEX);
+            ++nSleepers;
+            CONDITION.wait(lk, [this, &fReset] { return nChunks.load() > 0 || fReset.load(); });
+            --nSleepers;
+        }
+
+        return false;
+    }
+
+
+    void work_queue::set_capacity(uint32_t nCapacity)
+    {
+        nCapacityChunks = std::max((uint32_t)1, std::min(nCapacity, (uint32_t)WORK_RING_SIZE));
+    }
+
+
+    void work_queue::keep_best(work_info &work, std::vector<uint32_t> &vScores, uint32_t nKeep)
+    {
+        uint32_t nCandidates = work.nonce_offsets.size();
+        std::vector<uint32_t> vIndex(nCandidates);
+
+        for(uint32_t i = 0; i < nCandidates; ++i)
+            vIndex[i] = i;
+
+        std::stable_sort(vIndex.begin(), vIndex.end(), [&vScores](uint32_t a, uint32_t b)
+        {
+            return vScores[a] > vScores[b];
+        });
+
+        vIndex.resize(nKeep);
+        std::sort(vIndex.begin(), vIndex.end());
+
+        for(uint32_t i = 0; i < nKeep; ++i)
+        {
+            work.nonce_offsets[i] = work.nonce_offsets[vIndex[i]];
+            work.nonce_meta[i] = work.nonce_meta[vIndex[i]];
+            vScores[i] = vScores[vIndex[i]];
+        }
+
+        work.nonce_offsets.resize(nKeep);
+        work.nonce_meta.resize(nKeep);
+        vScores.resize(nKeep);
+    }
+
+
+    uint32_t work_queue::score(uint32_t nMeta, uint32_t nSieved)
+    {
+        uint32_t nSurvivors = ~nMeta & nSieved;
+        uint32_t nBest = 0;
+        uint32_t nRun = 0;
+        uint32_t t = 0;
+
+        /* Walk the surviving offsets, starting a new run at each gap that is too wide. */
+        for(; nSurvivors; nSurvivors &= (nSurvivors - 1))
+        {
+            uint32_t n = convert::ctz(nSurvivors);
+
+            if(nRun && vOffsets[n] - vOffsets[t] > CHAIN_GAP_MAX)
+                nRun = 0;
+
+            nBest = std::max(nBest, ++nRun);
+            t = n;
+        }
+
+        return nBest;
+    }
+
+
+    void work_queue::wake()
+    {
+        {
+            std::unique_lock<std::mutex> lk(MUTEX);
+        }
+
+        CONDITION.notify_all();
+    }
+
+
+    void work_queue::next_epoch()
+    {
+        ++nEpoch;
+
+        /* Drop the stale chunks now, rather than shed fresh work while they still count. */
+        clear();
+    }
+
+
+    void work_queue::clear()
+    {
+        work_info *pWork = nullptr;
+        uint32_t nClass = 0;
+
+        while((pWork = dequeue(nClass)) != nullptr)
+        {
+            delete pWork;
+            --nChunks;
+        }
+
+        uint32_t nTotal = nConsumers.load();
+        for(uint32_t i = 0; i < nTotal; ++i)
+        {
+            while((pWork = vDeques[i].steal()) != nullptr)
+            {
+                delete pWork;
+                --nChunks;
+            }
+        }
+    }
+
+
+    work_info *work_queue::dequeue(uint32_t &nClass)
+    {
+        for(nClass = 0; nClass < WORK_PRIORITY_CLASSES; ++nClass)
+        {
+            work_info *pWork = vRings[nClass].dequeue();
+            if(pWork)
+                return pWork;
+        }
+
+        return nullptr;
+    }
+
+
+    work_info *work_queue::try_pop(uint32_t nConsumer)
+    {
+        work_info *pWork = nullptr;
+
+        /* Test workers past the maximum have no deque of their own. */
+        bool fOwner = nConsumer < WORK_CONSUMERS_MAX;
+
+        if(fOwner)
+        {
+            /* Make the deque visible to thieves. */
+            uint32_t nTotal = nConsumers.load();
+            while(nTotal <= nConsumer && !nConsumers.compare_exchange_weak(nTotal, nConsumer + 1))
+                ;
+
+            pWork = vDeques[nConsumer].take();
+        }
+
+        /* Take a chunk from the best ring, and a few more of its class for the own deque. */
+        uint32_t nClass = 0;
+        if(!pWork && (pWork = dequeue(nClass)) != nullptr && fOwner)
+        {
+            for(uint32_t i = 1; i < WORK_BATCH_SIZE; ++i)
+            {
+                work_info *pExtra = vRings[nClass].dequeue();
+                if(!pExtra)
+                    break;
+
+                /* The deque is empty here, so there is always room. */
+                vDeques[nConsumer].push(pExtra);
+            }
+        }
+
+        /* Steal from the other test workers. */
+        uint32_t nTotal = nConsumers.load();
+        for(uint32_t i = 1; !pWork && i <= nTotal; ++i)
+        {
+            uint32_t nVictim = (nConsumer + i) % nTotal;
+            if(nVictim != nConsumer)
+                pWork = vDeques[nVictim].steal();
+        }
+
+        if(pWork)
+            --nChunks;
+
+        return pWork;
+    }
+
+}
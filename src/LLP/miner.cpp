@@ -88,11 +88,12 @@ namespace LLP
         vWorkers.clear();
         nReady = 0;
 
-        /* Clear the prime work queue on shutdown. */
+        /* Clear the prime work and verify queues, and the block contexts, on shutdown. */
         if(nChannels & 1)
         {
-            std::unique_lock<std::mutex> lk(LLC::g_work_mutex);
             LLC::g_work_queue.clear();
+            LLC::g_verify_queue.clear();
+            LLC::g_test_contexts.clear();
         }
     }
 
@@ -523,12 +524,9 @@ namespace LLP
             fPause = false;
         }
 
-        /* Clear the prime work queue for this round. */
+        /* Start a new round of prime work, dropping the work of the last one. */
         if(nChannels & 1)
-        {
-            std::unique_lock<std::mutex> lk(LLC::g_work_mutex);
-            LLC::g_work_queue.clear();
-        }
+            LLC::g_work_queue.next_epoch();
 
         /* Clear the submit queue. */
         std::unique_lock<std::mutex> lk(mut);
@@ -732,6 +730,9 @@ namespace LLP
             debug::log(0, "[PRIMES] ", std::setw(9), std::left, std::fixed, std::setprecision(3), WPS, " WP/s",
             " | ", std::fixed, std::setprecision(2), (double)bps / 1000000.0, " Mb/s",
             " | ", tps_gpu, " T/s GPU, ", tps_cpu, " T/s CPU | Ratio: ", std::setprecision(3), ratio, " %");
+
+            debug::log(1, "[PRIMES] Queue ", LLC::g_work_queue.size(), " chunks (", LLC::g_work_queue.pressure(), "%)",
+            " | ", LLC::g_work_queue.shed(), " candidates shed");
             debug::log(0, "");
 
 
@@ -139,6 +139,9 @@ namespace LLP
     void Worker::Stop()
     {
         fStop = true;
+
+        /* Wake up a proof that is blocked waiting for work. */
+        pProof->Reset();
     }
 
 
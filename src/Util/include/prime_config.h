@@ -27,6 +27,7 @@ extern std::vector<uint32_t> vOffsets;
 extern std::vector<uint32_t> vOffsetsA;
 extern std::vector<uint32_t> vOffsetsB;
 extern std::vector<uint32_t> vOffsetsT;
+extern uint32_t nOffsetPattern;
 
 
 
@@ -38,12 +39,29 @@ extern uint32_t nMaxCandidatesLog2[GPU_MAX];
 extern uint32_t  nTestLevels[GPU_MAX];
 extern uint32_t nSievesPerOrigin[GPU_MAX];
 
+extern uint32_t nCPUSievePrimesLog2;
+extern uint32_t nCPUSieveBitsLog2;
+extern uint32_t nCPUSegmentBitsLog2;
+extern uint32_t nCPUSievesPerOrigin;
+extern uint32_t nCPUComboThreshold;
+extern uint32_t nCPUPreTestMin;
+extern uint32_t nCPUPreTestMax;
+extern uint32_t nCPUSieveThreads;
+extern uint32_t nCPUTestThreads;
+extern uint32_t nCPUSharedSieve;
+extern uint32_t nCPUInterleave;
+extern uint32_t nCPUQueueChunks;
+extern uint32_t nCPUMinChain;
+extern uint32_t nCPUTestLevels;
+
 
 namespace prime
 {
     bool load_offsets();
     bool load_origins();
     void load_config(const std::vector<uint32_t>& indices);
+    void load_cpu_config();
+    bool save_cpu_config();
 }
 
 #endif
@@ -12,6 +12,8 @@
 ____________________________________________________________________________________________*/
 
 #include <LLC/include/global.h>
+#include <LLC/include/work_queue.h>
+#include <LLC/prime/pattern.h>
 #include <Util/include/debug.h>
 #include <Util/include/prime_config.h>
 #include <Util/include/ini_parser.h>
@@ -19,6 +21,8 @@ ________________________________________________________________________________
 #include <sstream>
 #include <string>
 #include <numeric>
+#include <algorithm>
+#include <limits>
 
 
 /* Sieve/Testing Specific Configurations. */
@@ -31,6 +35,9 @@ std::vector<uint32_t> vOffsetsA;
 std::vector<uint32_t> vOffsetsB;
 std::vector<uint32_t> vOffsetsT;
 
+/* The pattern the offsets match, selecting the specialized kernels. */
+uint32_t nOffsetPattern = 0;
+
 
 /* GPU Specific Configurations */
 uint32_t nSievePrimeLimit = 1 << 24;
@@ -41,6 +48,23 @@ uint32_t nMaxCandidatesLog2[GPU_MAX] = { 0 };
 uint32_t nTestLevels[GPU_MAX] = { 0 };
 uint32_t nSievesPerOrigin[GPU_MAX] = { 0 };
 
+
+/* CPU Specific Configurations */
+uint32_t nCPUSievePrimesLog2 = 23;
+uint32_t nCPUSieveBitsLog2 = 23;
+uint32_t nCPUSegmentBitsLog2 = 18;
+uint32_t nCPUSievesPerOrigin = 5;
+uint32_t nCPUComboThreshold = 8;
+uint32_t nCPUPreTestMin = 1;
+uint32_t nCPUPreTestMax = 4;
+uint32_t nCPUSieveThreads = 0;
+uint32_t nCPUTestThreads = 0;
+uint32_t nCPUSharedSieve = 1;
+uint32_t nCPUInterleave = 1;
+uint32_t nCPUQueueChunks = 4096;
+uint32_t nCPUMinChain = 0;
+uint32_t nCPUTestLevels = 1;
+
 namespace prime
 {
     /* Load the prime mining configuration for each GPU (Hash mining auto-computed.) */
@@ -108,6 +132,184 @@ namespace prime
         }
     }
 
+    /* Clamp a [CPU] parameter to its valid range, logging when it was out of it. */
+    static void clamp_cpu(const char *pName, uint32_t &nValue, uint32_t nMin, uint32_t nMax)
+    {
+        /* The value is parsed as a signed integer, so a negative one is below any range. */
+        int64_t nParsed = static_cast<int32_t>(nValue);
+        uint32_t nClamped = static_cast<uint32_t>(std::min(std::max(nParsed, (int64_t)nMin), (int64_t)nMax));
+
+        if(nClamped == nValue)
+            return;
+
+        debug::log(0, "[CPU] ", pName, " = ", nParsed, " is out of range [", nMin, ", ", nMax, "], using ", nClamped);
+        nValue = nClamped;
+    }
+
+
+    /* Load the prime mining configuration for the CPU sieve and test workers. */
+    void load_cpu_config()
+    {
+        std::ifstream t("config.ini");
+        std::stringstream buffer;
+        buffer << t.rdbuf();
+        std::string config = buffer.str();
+
+        IniParser parser;
+        if (parser.Parse(config.c_str()) == false)
+        {
+            debug::error("Unable to parse config.ini");
+            return;
+        }
+
+        #define PARSE_CPU(X, Y, MIN, MAX) parser.GetValueAsInteger("CPU", #X, (int*)&Y); clamp_cpu(#X, Y, MIN, MAX);
+
+        /* Parse the [CPU] parameters in config.ini, keeping the defaults for missing ones
+           and clamping the rest to the ranges the sieve and test workers can run with. */
+        PARSE_CPU(nSievePrimesLog2, nCPUSievePrimesLog2, 16, 24);
+        PARSE_CPU(nSieveBitsLog2,   nCPUSieveBitsLog2,   16, 26);
+        PARSE_CPU(nSegmentBitsLog2, nCPUSegmentBitsLog2, 12, nCPUSieveBitsLog2);
+        PARSE_CPU(nSievesPerOrigin, nCPUSievesPerOrigin, 1, std::numeric_limits<int32_t>::max());
+        PARSE_CPU(nComboThreshold,  nCPUComboThreshold,  0, 32);
+        PARSE_CPU(nPreTestMin,      nCPUPreTestMin,      0, 32);
+        PARSE_CPU(nPreTestMax,      nCPUPreTestMax,      nCPUPreTestMin, 32);
+        PARSE_CPU(nSieveThreads,    nCPUSieveThreads,    0, WORK_CONSUMERS_MAX);
+        PARSE_CPU(nTestThreads,     nCPUTestThreads,     0, WORK_CONSUMERS_MAX);
+        PARSE_CPU(nSharedSieve,     nCPUSharedSieve,     0, 1);
+        PARSE_CPU(nInterleave,      nCPUInterleave,      1, 16);
+        PARSE_CPU(nQueueChunks,     nCPUQueueChunks,     1, WORK_RING_SIZE);
+        PARSE_CPU(nMinChain,        nCPUMinChain,        0, MAX_CHAIN_LENGTH - 1);
+        PARSE_CPU(nTestLevels,      nCPUTestLevels,      1, 32);
+
+        #undef PARSE_CPU
+    }
+
+
+    /* Replace the value of a key = value line, keeping the spacing and any trailing comment. */
+    static std::string set_ini_value(const std::string &strEntry, size_t nEquals, const std::string &strValue)
+    {
+        size_t nValue = strEntry.find_first_not_of(" \t", nEquals + 1);
+        if(nValue == std::string::npos)
+            nValue = strEntry.size();
+
+        size_t nComment = strEntry.find_first_of(";#", nValue);
+        if(nComment == std::string::npos)
+            return strEntry.substr(0, nValue) + strValue;
+
+        /* Keep the comment in its column if the new value fits, otherwise a space after it. */
+        std::string strField = strValue;
+        if(strField.size() < nComment - nValue)
+            strField.resize(nComment - nValue, ' ');
+        else
+            strField += ' ';
+
+        return strEntry.substr(0, nValue) + strField + strEntry.substr(nComment);
+    }
+
+
+    /* Save the CPU configuration into the [CPU] section of config.ini, leaving the rest as is. */
+    bool save_cpu_config()
+    {
+        std::ifstream fin("config.ini");
+        std::vector<std::string> vLines;
+        std::string strLine;
+        std::string strEnd = "\n";
+
+        /* Read the lines, keeping the line endings the file already uses. */
+        while(std::getline(fin, strLine))
+        {
+            if(!strLine.empty() && strLine.back() == '\r')
+            {
+                strLine.pop_back();
+                strEnd = "\r\n";
+            }
+
+            vLines.push_back(strLine);
+        }
+
+        fin.close();
+
+        std::vector<std::pair<std::string, uint32_t>> vValues;
+        vValues.push_back(std::make_pair("nSievePrimesLog2", nCPUSievePrimesLog2));
+        vValues.push_back(std::make_pair("nSieveBitsLog2",   nCPUSieveBitsLog2));
+        vValues.push_back(std::make_pair("nSegmentBitsLog2", nCPUSegmentBitsLog2));
+        vValues.push_back(std::make_pair("nSievesPerOrigin", nCPUSievesPerOrigin));
+        vValues.push_back(std::make_pair("nComboThreshold",  nCPUComboThreshold));
+        vValues.push_back(std::make_pair("nPreTestMin",      nCPUPreTestMin));
+        vValues.push_back(std::make_pair("nPreTestMax",      nCPUPreTestMax));
+        vValues.push_back(std::make_pair("nSieveThreads",    nCPUSieveThreads));
+        vValues.push_back(std::make_pair("nTestThreads",     nCPUTestThreads));
+        vValues.push_back(std::make_pair("nSharedSieve",     nCPUSharedSieve));
+        vValues.push_back(std::make_pair("nInterleave",      nCPUInterleave));
+        vValues.push_back(std::make_pair("nQueueChunks",     nCPUQueueChunks));
+        vValues.push_back(std::make_pair("nMinChain",        nCPUMinChain));
+        vValues.push_back(std::make_pair("nTestLevels",      nCPUTestLevels));
+
+        /* Find the existing section, which runs up to the next section or blank line. */
+        uint32_t nBegin = 0;
+        while(nBegin < vLines.size() && vLines[nBegin].compare(0, 5, "[CPU]") != 0)
+            ++nBegin;
+
+        /* Without a section, append a new one after a blank line. */
+        if(nBegin == vLines.size())
+        {
+            vLines.push_back("");
+            vLines.push_back("[CPU]");
+        }
+
+        uint32_t nEnd = nBegin + 1;
+        while(nEnd < vLines.size() && !vLines[nEnd].empty() && vLines[nEnd][0] != '[')
+            ++nEnd;
+
+        std::vector<bool> vWritten(vValues.size(), false);
+
+        /* Rewrite only the values of the keys already in the section, keeping their comments. */
+        for(uint32_t nLine = nBegin + 1; nLine < nEnd; ++nLine)
+        {
+            std::string &strEntry = vLines[nLine];
+
+            size_t nEquals = strEntry.find('=');
+            if(nEquals == std::string::npos)
+                continue;
+
+            std::string strKey = strEntry.substr(0, nEquals);
+            strKey.erase(strKey.find_last_not_of(" \t") + 1);
+            strKey.erase(0, strKey.find_first_not_of(" \t"));
+
+            for(uint32_t i = 0; i < vValues.size(); ++i)
+            {
+                if(vWritten[i] || vValues[i].first != strKey)
+                    continue;
+
+                strEntry = set_ini_value(strEntry, nEquals, std::to_string(vValues[i].second));
+                vWritten[i] = true;
+                break;
+            }
+        }
+
+        /* Add the keys the section doesn't have yet at its end. */
+        std::vector<std::string> vAdded;
+        for(uint32_t i = 0; i < vValues.size(); ++i)
+        {
+            if(!vWritten[i])
+                vAdded.push_back(vValues[i].first + " =" + std::string(std::max(1, 21 - (int)vValues[i].first.size()), ' ') + std::to_string(vValues[i].second));
+        }
+
+        vLines.insert(vLines.begin() + nEnd, vAdded.begin(), vAdded.end());
+
+        std::ofstream fout("config.ini", std::ios::trunc);
+        if(!fout.is_open())
+            return debug::error("could not write config.ini!");
+
+        for(const auto& line : vLines)
+            fout << line << strEnd;
+
+        fout.close();
+
+        return true;
+    }
+
+
     /* Helper function to read the next offset pattern. */
     bool read_offset_pattern(std::ifstream &fin,
     std::vector<uint32_t> &offsets,
@@ -217,6 +419,10 @@ namespace prime
         }
 
         fin.close();
+
+        /* Select the kernels specialized for the pattern, if there are any. */
+        nOffsetPattern = LLC::find_pattern();
+        debug::log(0, "Offset pattern kernels: ", nOffsetPattern == PATTERN_GENERIC ? "generic" : "specialized");
         debug::log(0, "");
 
         return true;
@@ -15,10 +15,13 @@ ________________________________________________________________________________
 
 #include <LLC/include/global.h>
 #include <LLC/prime/origins.h>
+#include <LLC/prime/autotune.h>
+#include <LLC/prime/fermat.h>
 #include <LLC/types/cuda_prime.h>
 #include <LLC/types/cuda_hash.h>
 #include <LLC/types/cpu_hash.h>
 #include <LLC/types/cpu_primetest.h>
+#include <LLC/types/cpu_primeverify.h>
 #include <LLC/types/cpu_primesieve.h>
 
 #include <LLP/templates/miner.h>
@@ -50,11 +53,17 @@ int main(int argc, char **argv)
     uint16_t port = config::GetArg(std::string("-port"), config::fTestNet ? 8325 : 9325);
     uint16_t nTimeout = config::GetArg(std::string("-timeout"), 10);
 
+    /* Load the CPU prime mining configuration. */
+    prime::load_cpu_config();
+
+    /* Bound the candidate queue between the prime sieves and test workers. */
+    LLC::g_work_queue.set_capacity(nCPUQueueChunks);
+
     /* Get the number of CUDA Devices. */
     uint32_t nDevices = cuda_num_devices();
 
     /* Get the number of CPU threads allowed. */
-    uint32_t nThreads = config::GetArg(std::string("-threads"), std::thread::hardware_concurrency());
+    uint32_t nThreads = config::GetArg(std::string("-threads"), nCPUTestThreads ? nCPUTestThreads : std::thread::hardware_concurrency());
 
     /* The comma seperated index list passed in from command line. */
     std::string strPrimeIndices = config::GetArg(std::string("-prime"), "");
@@ -86,7 +95,7 @@ int main(int argc, char **argv)
     }
 
     /* Get the number of CPU cores alloacted for prime/and or hash mining. */
-    uint32_t nPrimeCPU = config::GetArg(std::string("-cpuprime"), 0);
+    uint32_t nPrimeCPU = config::GetArg(std::string("-cpuprime"), nCPUSieveThreads);
     uint32_t nHashCPU = config::GetArg(std::string("-cpuhash"), 0);
 
 
@@ -106,6 +115,32 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    /* If the Fermat benchmark is specified, time the Fermat tests against mpz_powm. */
+    if(config::GetBoolArg(std::string("-fermatbench")))
+    {
+        LLC::FermatBenchmark(config::GetArg(std::string("-fermatbits"), 1024),
+                             config::GetArg(std::string("-fermattests"), 2048));
+
+        return 0;
+    }
+
+    /* If CPU auto-tune is specified, find the best CPU sieve settings for this host. */
+    if(config::GetBoolArg(std::string("-cpuautotune")))
+    {
+        if(!prime::load_offsets())
+            return 0;
+
+        LLC::InitializePrimes();
+
+        if(prime::load_origins())
+            LLC::AutoTuneCPU(config::GetArg(std::string("-threads"), std::thread::hardware_concurrency()),
+                             config::GetArg(std::string("-autotunetime"), 30));
+
+        LLC::FreePrimes();
+
+        return 0;
+    }
+
     /* If there are any prime workers at all, load primes. */
     if(nPrimeGPU || nPrimeCPU)
     {
@@ -132,15 +167,18 @@ int main(int argc, char **argv)
     for(uint32_t tid = 0; tid < nPrimeGPU; ++tid)
         Miner.AddWorker<LLC::PrimeCUDA>(primeIndices[tid]);
 
-    /* Add CPU prime sieve workers to the miner. */
+    /* Add CPU prime sieve workers to the miner. With a shared block only the
+       first one requests blocks, and the others sieve the block it publishes. */
     for(uint32_t tid = 0; tid < nPrimeCPU; ++tid)
-        Miner.AddWorker<LLC::PrimeSieveCPU>(tid);
+        Miner.AddWorker<LLC::PrimeSieveCPU>(tid, !nCPUSharedSieve || tid == 0);
 
-    /* Add CPU prime test workers to the miner. */
+    /* Add CPU prime test workers to the miner, and the verifier of the chains they find. */
     if(nPrimeGPU || nPrimeCPU)
     {
         for(uint32_t tid = 0; tid < nThreads; ++tid)
             Miner.AddWorker<LLC::PrimeTestCPU>(tid, false);
+
+        Miner.AddWorker<LLC::PrimeVerifyCPU>(0, false);
     }
 
 